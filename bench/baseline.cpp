@@ -0,0 +1,131 @@
+#include "baseline.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    // 防止校准内核被优化掉
+    volatile std::size_t calibrationSink = 0;
+
+    // 很小的脚本只有计时噪声, 超出基线的部分小于校准内核耗时的 1% 时不算回归
+    constexpr double MIN_COST_SLACK = 0.01;
+
+    void calibrationKernel()
+    {
+        std::unordered_map<std::string, long long> counts;
+        for (int i = 0; i < 20000; ++i)
+            counts["key_" + std::to_string(i % 4000)] += i;
+
+        std::string text;
+        for (int i = 0; i < 20000; ++i)
+            text += "piece_" + std::to_string(i) + ";";
+
+        std::vector<unsigned> values(50000);
+        unsigned x = 12345;
+        for (auto &v : values)
+        {
+            x = x * 1103515245u + 12345u;
+            v = x >> 8;
+        }
+        std::sort(values.begin(), values.end());
+
+        calibrationSink = counts.size() + text.size() + values[values.size() / 2];
+    }
+}
+
+double calibrationMs(int runs)
+{
+    double best = 0;
+    for (int r = 0; r < std::max(runs, 1); ++r)
+    {
+        auto start = std::chrono::steady_clock::now();
+        calibrationKernel();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (r == 0 || ms < best)
+            best = ms;
+    }
+    return best;
+}
+
+json updateBaseline(json baselineFile, const json &report, const std::string &key)
+{
+    if (!baselineFile.is_object())
+        baselineFile = json::object();
+    baselineFile["schema_version"] = report["schema_version"];
+
+    json entry;
+    entry["runs"] = report["runs"];
+    entry["scale"] = report["scale"];
+    entry["peak_rss_kb"] = report["peak_rss_kb"];
+    json workloads = json::object();
+    for (auto &w : report["workloads"])
+    {
+        workloads[w["name"].get<std::string>()] = {{"normalized_cost", w["normalized_cost"]},
+                                                   {"objects_per_sec", w["objects_per_sec"]}};
+    }
+    entry["workloads"] = workloads;
+    baselineFile["baselines"][key] = entry;
+    return baselineFile;
+}
+
+int compareBaseline(const json &report, const json &baselineFile, const std::string &key, double tolerance)
+{
+    if (!baselineFile.contains("baselines") || !baselineFile["baselines"].contains(key))
+    {
+        std::cerr << "No performance baseline for build type '" << key << "', skipping comparison" << std::endl;
+        return 2;
+    }
+    const json &base = baselineFile["baselines"][key];
+
+    std::unordered_map<std::string, const json *> current;
+    for (auto &w : report["workloads"])
+        current[w["name"].get<std::string>()] = &w;
+
+    double limit = 1.0 + tolerance;
+    int regressions = 0;
+    std::cerr << std::fixed << std::setprecision(3);
+    std::cerr << std::setw(24) << "workload" << std::setw(12) << "baseline" << std::setw(12) << "current"
+              << std::setw(10) << "ratio" << "\n";
+    for (auto &entry : base["workloads"].items())
+    {
+        auto it = current.find(entry.key());
+        if (it == current.end())
+        {
+            std::cerr << "REGRESSION: workload '" << entry.key() << "' is missing from the run" << std::endl;
+            ++regressions;
+            continue;
+        }
+        double expected = entry.value()["normalized_cost"].get<double>();
+        double actual = (*it->second)["normalized_cost"].get<double>();
+        double ratio = expected > 0 ? actual / expected : 0.0;
+        bool slow = ratio > limit && actual - expected > MIN_COST_SLACK;
+        std::cerr << std::setw(24) << entry.key() << std::setw(12) << expected << std::setw(12) << actual
+                  << std::setw(10) << ratio << (slow ? "  REGRESSION" : "") << "\n";
+        if (slow)
+            ++regressions;
+    }
+
+    if (base.contains("peak_rss_kb") && base["peak_rss_kb"].is_number() && report["peak_rss_kb"].is_number())
+    {
+        double expected = base["peak_rss_kb"].get<double>();
+        double actual = report["peak_rss_kb"].get<double>();
+        bool grown = expected > 0 && actual > expected * limit;
+        std::cerr << std::setw(24) << "peak_rss_kb" << std::setw(12) << expected << std::setw(12) << actual
+                  << std::setw(10) << (expected > 0 ? actual / expected : 0.0) << (grown ? "  REGRESSION" : "") << "\n";
+        if (grown)
+            ++regressions;
+    }
+
+    if (regressions > 0)
+    {
+        std::cerr << "PERFORMANCE REGRESSION: " << regressions << " check(s) exceeded the baseline by more than "
+                  << std::setprecision(0) << tolerance * 100 << "%" << std::endl;
+        return 1;
+    }
+    std::cerr << "Performance within " << std::setprecision(0) << tolerance * 100 << "% of baseline" << std::endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+#include <string>
+
+using json = nlohmann::json;
+
+// Performance baselines 性能基线
+// 基线文件按构建类型(default/Release/Debug...)分别保存每个负载的归一化耗时和进程内存峰值.
+// 归一化耗时 = 负载最短总耗时 / 校准内核耗时, 用于抵消不同机器之间的速度差异
+
+// 校准内核: 哈希表、字符串拼接和排序的固定混合负载, 返回最短耗时(ms)
+double calibrationMs(int runs);
+
+// 把报告写入基线文件中 key 对应的条目, 返回新的基线文件内容
+json updateBaseline(json baselineFile, const json &report, const std::string &key);
+
+// 比较报告和基线; 耗时或内存超过基线 (1 + tolerance) 倍时视为回归.
+// 返回 0 表示通过, 1 表示回归, 2 表示基线中没有 key 对应的条目
+int compareBaseline(const json &report, const json &baselineFile, const std::string &key, double tolerance);
@@ -0,0 +1,384 @@
+#include "workloads.h"
+#include "baseline.h"
+#include "perf_counters.h"
+#include "lexer_scan.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "stats.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// luduscript_bench: 对合成脚本分别统计词法分析、语法分析、执行和序列化的耗时,
+// 重复多次后输出中位数和百分位数(JSON)
+
+namespace
+{
+    constexpr int SCHEMA_VERSION = 1;
+
+    // ctest 中表示跳过的返回值
+    constexpr int EXIT_SKIPPED = 77;
+    constexpr int EXIT_REGRESSION = 4;
+
+    struct BenchOptions
+    {
+        int runs = 10;
+        int warmup = 1;
+        int scale = 1;
+        unsigned threads = 1; // 默认单线程, 结果不受机器核数影响
+        std::vector<std::string> workloads;
+        std::string outputFile;
+        std::string dump; // 只打印该负载的脚本
+        std::string examplesDir; // 同时运行该目录下的 *.gen 脚本
+        std::string baselineFile;
+        std::string baselineKey = "default"; // 基线条目, 一般为构建类型
+        double tolerance = 1.0;
+        bool writeBaseline = false; // 用本次结果更新基线而不是比较
+        bool counters = false;      // 用 perf_event_open 统计各阶段的硬件计数器
+        std::string scan;           // 强制使用的空白扫描实现, 为空时自动选择
+    };
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Nearest-rank percentile of sorted samples 最近秩百分位数
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.999999);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    json summarize(std::vector<double> samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (double s : samples)
+            sum += s;
+        return {{"min_ms", samples.front()},
+                {"median_ms", percentile(samples, 50)},
+                {"p90_ms", percentile(samples, 90)},
+                {"p99_ms", percentile(samples, 99)},
+                {"max_ms", samples.back()},
+                {"mean_ms", sum / static_cast<double>(samples.size())}};
+    }
+
+    // 无法统计的计数器输出为 null
+    json counterValue(double v)
+    {
+        return std::isnan(v) ? json(nullptr) : json(v);
+    }
+
+    // 每次运行的平均计数和 IPC
+    json summarizeCounters(const PerfCounters::Values &sums, int runs)
+    {
+        json result = json::object();
+        for (int c = 0; c < PerfCounters::COUNT; ++c)
+            result[PerfCounters::name(static_cast<PerfCounters::Counter>(c))] = counterValue(sums[c] / runs);
+        double cycles = sums[PerfCounters::CYCLES];
+        double ipc = cycles > 0 ? sums[PerfCounters::INSTRUCTIONS] / cycles : NAN;
+        result["ipc"] = counterValue(ipc);
+        return result;
+    }
+
+    json runWorkload(const Workload &w, const BenchOptions &opts, double calibration, PerfCounters *counters)
+    {
+        std::map<std::string, std::vector<double>> samples;
+        std::map<std::string, PerfCounters::Values> counterSums;
+        // 计数器的启停放在计时区间之外
+        auto startCounters = [&]()
+        {
+            if (counters)
+                counters->start();
+        };
+        PerfCounters::Values lexCounters{}, parseCounters{}, executeCounters{}, serializeCounters{};
+        auto stopCounters = [&](PerfCounters::Values &values)
+        {
+            if (counters)
+                values = counters->stop();
+        };
+        size_t tokens = 0, astNodes = 0, objects = 0, outputBytes = 0;
+
+        for (int run = 0; run < opts.warmup + opts.runs; ++run)
+        {
+            bool measured = run >= opts.warmup;
+
+            // Lexer only 只做词法分析(与 Parser 相同的一次性 token 数组)
+            startCounters();
+            auto start = std::chrono::steady_clock::now();
+            Lexer lex(w.source);
+            tokens = lex.tokenizeAll().size() - 1; // 不计 END
+            double lexMs = elapsedMs(start);
+            stopCounters(lexCounters);
+
+            // Parser 语法分析(包含按需进行的词法分析)
+            startCounters();
+            start = std::chrono::steady_clock::now();
+            auto program = parseProgram(w.source, opts.threads);
+            double parseMs = elapsedMs(start);
+            stopCounters(parseCounters);
+
+            Interpreter interpreter;
+            interpreter.setThreads(opts.threads);
+            startCounters();
+            start = std::chrono::steady_clock::now();
+            interpreter.execute(program.get());
+            double executeMs = elapsedMs(start);
+            stopCounters(executeCounters);
+
+            startCounters();
+            start = std::chrono::steady_clock::now();
+            std::string output = interpreter.getOutput(false);
+            double serializeMs = elapsedMs(start);
+            stopCounters(serializeCounters);
+
+            if (!measured)
+                continue;
+            samples["lex"].push_back(lexMs);
+            samples["parse"].push_back(parseMs);
+            samples["execute"].push_back(executeMs);
+            samples["serialize"].push_back(serializeMs);
+            samples["total"].push_back(parseMs + executeMs + serializeMs);
+
+            if (counters)
+            {
+                auto &total = counterSums["total"];
+                const std::pair<const char *, const PerfCounters::Values *> phaseCounters[] = {
+                    {"lex", &lexCounters}, {"parse", &parseCounters}, {"execute", &executeCounters}, {"serialize", &serializeCounters}};
+                for (auto &phase : phaseCounters)
+                {
+                    auto &sums = counterSums[phase.first];
+                    for (int c = 0; c < PerfCounters::COUNT; ++c)
+                    {
+                        sums[c] += (*phase.second)[c];
+                        // 与耗时一致, total 不包含单独测量的词法分析
+                        if (phase.second != &lexCounters)
+                            total[c] += (*phase.second)[c];
+                    }
+                }
+            }
+
+            astNodes = 0;
+            for (auto &stmt : program->stmts)
+                astNodes += countNodes(stmt.get());
+            objects = interpreter.objectCount();
+            outputBytes = output.size();
+        }
+
+        json phases = json::object();
+        for (auto &entry : samples)
+            phases[entry.first] = summarize(entry.second);
+
+        // 吞吐量按总耗时中位数计算, 回归比较使用最短耗时, 受噪声影响较小
+        double medianSec = phases["total"]["median_ms"].get<double>() / 1000.0;
+        double minMs = phases["total"]["min_ms"].get<double>();
+        double lexSec = phases["lex"]["median_ms"].get<double>() / 1000.0;
+
+        json result = {{"name", w.name},
+                {"objects_per_sec", medianSec > 0 ? static_cast<double>(objects) / medianSec : 0.0},
+                {"mb_per_sec", medianSec > 0 ? static_cast<double>(outputBytes) / 1e6 / medianSec : 0.0},
+                {"lex_mb_per_sec", lexSec > 0 ? static_cast<double>(w.source.size()) / 1e6 / lexSec : 0.0},
+                {"normalized_cost", calibration > 0 ? minMs / calibration : 0.0},
+                {"params", w.params},
+                {"source_bytes", w.source.size()},
+                {"tokens", tokens},
+                {"ast_nodes", astNodes},
+                {"objects", objects},
+                {"output_bytes", outputBytes},
+                {"phases", phases}};
+
+        if (counters)
+        {
+            json phaseCounters = json::object();
+            for (auto &entry : counterSums)
+                phaseCounters[entry.first] = summarizeCounters(entry.second, opts.runs);
+            result["ipc"] = phaseCounters["total"]["ipc"];
+            result["counters"] = phaseCounters;
+        }
+        return result;
+    }
+
+    void usage(const char *argv0)
+    {
+        std::cerr << "Usage: " << argv0 << " [--runs <n>] [--warmup <n>] [--scale <n>] [--threads <n>]"
+                  << " [--workload <name>]... [--output <file.json>] [--dump <name>]\n"
+                  << "       [--counters] [--scan scalar|sse2|avx2]\n"
+                  << "       [--examples <dir>] [--baseline <file.json> [--baseline-key <key>] [--tolerance <f>] [--write-baseline]]\n"
+                  << "Workloads:";
+        for (auto &name : workloadNames())
+            std::cerr << " " << name;
+        std::cerr << "\n";
+    }
+}
+
+int main(int argc, char **argv)
+{
+    BenchOptions opts;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--runs" && hasValue)
+                opts.runs = std::stoi(argv[++i]);
+            else if (arg == "--warmup" && hasValue)
+                opts.warmup = std::stoi(argv[++i]);
+            else if (arg == "--scale" && hasValue)
+                opts.scale = std::stoi(argv[++i]);
+            else if (arg == "--threads" && hasValue)
+                opts.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+            else if (arg == "--workload" && hasValue)
+                opts.workloads.push_back(argv[++i]);
+            else if (arg == "--output" && hasValue)
+                opts.outputFile = argv[++i];
+            else if (arg == "--dump" && hasValue)
+                opts.dump = argv[++i];
+            else if (arg == "--examples" && hasValue)
+                opts.examplesDir = argv[++i];
+            else if (arg == "--baseline" && hasValue)
+                opts.baselineFile = argv[++i];
+            else if (arg == "--baseline-key" && hasValue)
+                opts.baselineKey = argv[++i];
+            else if (arg == "--tolerance" && hasValue)
+                opts.tolerance = std::stod(argv[++i]);
+            else if (arg == "--scan" && hasValue)
+                opts.scan = argv[++i];
+            else if (arg == "--counters")
+                opts.counters = true;
+            else if (arg == "--write-baseline")
+                opts.writeBaseline = true;
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        if (opts.runs < 1 || opts.warmup < 0)
+        {
+            std::cerr << "--runs must be at least 1 and --warmup must not be negative" << std::endl;
+            return 1;
+        }
+
+        if (!opts.dump.empty())
+        {
+            std::cout << makeWorkload(opts.dump, opts.scale).source;
+            return 0;
+        }
+
+        if (!opts.scan.empty())
+            setScanImplementation(opts.scan);
+
+        if (opts.workloads.empty())
+            opts.workloads = workloadNames();
+
+        std::vector<Workload> workloads;
+        for (auto &name : opts.workloads)
+            workloads.push_back(makeWorkload(name, opts.scale));
+        if (!opts.examplesDir.empty())
+            for (auto &w : loadExamples(opts.examplesDir))
+                workloads.push_back(std::move(w));
+
+        // 计数器不可用时退回到只报告墙钟时间
+        std::unique_ptr<PerfCounters> counters;
+        json countersInfo = nullptr;
+        if (opts.counters)
+        {
+            counters = std::make_unique<PerfCounters>();
+            countersInfo = {{"available", counters->available()}};
+            if (!counters->available())
+            {
+                std::cerr << "Hardware counters unavailable, reporting wall time only: " << counters->error() << std::endl;
+                countersInfo["error"] = counters->error();
+                counters.reset();
+            }
+            else
+            {
+                json missing = json::array();
+                for (int c = 0; c < PerfCounters::COUNT; ++c)
+                    if (!counters->has(static_cast<PerfCounters::Counter>(c)))
+                        missing.push_back(PerfCounters::name(static_cast<PerfCounters::Counter>(c)));
+                if (!missing.empty())
+                    countersInfo["unsupported"] = missing;
+            }
+        }
+
+        double calibration = calibrationMs(opts.warmup + opts.runs);
+        json results = json::array();
+        for (auto &w : workloads)
+        {
+            std::cerr << "Running " << w.name << " (" << w.source.size() << " bytes)..." << std::endl;
+            results.push_back(runWorkload(w, opts, calibration, counters.get()));
+            if (results.back().contains("ipc") && !results.back()["ipc"].is_null())
+                std::cerr << "  IPC " << results.back()["ipc"].get<double>() << std::endl;
+        }
+
+        long long rss = RunStats::readPeakRssKb();
+        json report = {{"schema_version", SCHEMA_VERSION},
+                       {"runs", opts.runs},
+                       {"warmup", opts.warmup},
+                       {"scale", opts.scale},
+                       {"threads", opts.threads},
+                       {"calibration_ms", calibration},
+                       {"peak_rss_kb", rss >= 0 ? json(rss) : json(nullptr)},
+                       {"counters", countersInfo},
+                       {"scan", scanImplementation()},
+                       {"workloads", results}};
+
+        if (!opts.outputFile.empty())
+        {
+            std::ofstream ofs(opts.outputFile);
+            if (!ofs)
+            {
+                std::cerr << "Cannot write to " << opts.outputFile << std::endl;
+                return 3;
+            }
+            ofs << report.dump(2) << std::endl;
+            std::cerr << "Report saved to " << opts.outputFile << std::endl;
+        }
+        else
+        {
+            std::cout << report.dump(2) << std::endl;
+        }
+
+        if (opts.baselineFile.empty())
+            return 0;
+
+        json baseline;
+        if (std::filesystem::exists(opts.baselineFile))
+            baseline = json::parse(readFile(opts.baselineFile));
+
+        if (opts.writeBaseline)
+        {
+            std::ofstream bfs(opts.baselineFile);
+            if (!bfs)
+            {
+                std::cerr << "Cannot write to " << opts.baselineFile << std::endl;
+                return 3;
+            }
+            bfs << updateBaseline(baseline, report, opts.baselineKey).dump(2) << std::endl;
+            std::cerr << "Baseline '" << opts.baselineKey << "' saved to " << opts.baselineFile << std::endl;
+            return 0;
+        }
+
+        int result = compareBaseline(report, baseline, opts.baselineKey, opts.tolerance);
+        if (result == 2)
+            return EXIT_SKIPPED;
+        return result == 0 ? 0 : EXIT_REGRESSION;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,81 @@
+#include "legacy_engine.h"
+
+// 旧引擎使用的标准库和 JSON 库要先在全局命名空间中包含,
+// 之后源文件中的 #include 因为头文件保护而不会再展开到 ludus_legacy 命名空间内
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "nlohmann/json.hpp"
+
+namespace ludus_legacy
+{
+#include "ludus_legacy/LuduScript.cpp"
+}
+
+namespace
+{
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool isIdentChar(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+}
+
+namespace legacy_engine
+{
+    std::string run(const std::string &source, Timings &t)
+    {
+        // 与旧版 main_inner 的流程相同, 只是分别计时且不写文件
+        auto start = std::chrono::steady_clock::now();
+        ludus_legacy::Parser parser(source);
+        auto program = parser.parseProgram();
+        t.parseMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        ludus_legacy::Env env;
+        for (auto &st : program->stmts)
+            ludus_legacy::execStmt(st.get(), env);
+        t.executeMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        std::string output = env.output.dump();
+        t.serializeMs = elapsedMs(start);
+        return output;
+    }
+
+    std::string toLegacyDialect(const std::string &source)
+    {
+        std::string result;
+        result.reserve(source.size());
+        bool inString = false;
+        for (size_t i = 0; i < source.size(); ++i)
+        {
+            char c = source[i];
+            if (c == '"' && (i == 0 || source[i - 1] != '\\'))
+                inString = !inString;
+            if (!inString && source.compare(i, 4, "num(") == 0 && (i == 0 || !isIdentChar(source[i - 1])))
+            {
+                result += "int(";
+                i += 3;
+                continue;
+            }
+            result += c;
+        }
+        return result;
+    }
+}
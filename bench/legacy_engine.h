@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+// Legacy engine 旧版单文件引擎(src/ludus_legacy/LuduScript.cpp)的库接口,
+// 其全部符号都在 ludus_legacy 命名空间中, 可以和当前引擎链接到同一个程序
+namespace legacy_engine
+{
+    struct Timings
+    {
+        double parseMs = 0;
+        double executeMs = 0;
+        double serializeMs = 0;
+    };
+
+    // 运行旧引擎并返回紧凑的 JSON 输出, 出错时抛出 std::runtime_error
+    std::string run(const std::string &source, Timings &t);
+
+    // 旧引擎用 int 声明数值, 把当前语法中的 num( 改写为 int(
+    std::string toLegacyDialect(const std::string &source);
+}
@@ -0,0 +1,247 @@
+#include "workloads.h"
+#include "legacy_engine.h"
+#include "parser.h"
+#include "interpreter.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// luduscript_legacy_bench: 在相同的脚本上运行旧版引擎和当前引擎,
+// 报告各阶段耗时中位数的比值(旧/新, 大于 1 表示当前引擎更快)以及输出差异
+
+namespace
+{
+    constexpr int SCHEMA_VERSION = 1;
+    constexpr size_t MAX_REPORTED_DIFFS = 5;
+
+    struct CompareOptions
+    {
+        int runs = 5;
+        int warmup = 1;
+        int scale = 1;
+        std::vector<std::string> workloads;
+        std::string examplesDir;
+        std::string outputFile;
+    };
+
+    using PhaseSamples = std::map<std::string, std::vector<double>>;
+
+    double elapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    double median(std::vector<double> samples)
+    {
+        std::sort(samples.begin(), samples.end());
+        return samples[(samples.size() - 1) / 2];
+    }
+
+    // 运行一个引擎, 返回最后一次的输出; 出错时把错误信息写入 error
+    template <typename RunOnce>
+    std::string measure(const CompareOptions &opts, PhaseSamples &samples, std::string &error, RunOnce runOnce)
+    {
+        std::string output;
+        try
+        {
+            for (int run = 0; run < opts.warmup + opts.runs; ++run)
+            {
+                double parseMs = 0, executeMs = 0, serializeMs = 0;
+                output = runOnce(parseMs, executeMs, serializeMs);
+                if (run < opts.warmup)
+                    continue;
+                samples["parse"].push_back(parseMs);
+                samples["execute"].push_back(executeMs);
+                samples["serialize"].push_back(serializeMs);
+                samples["total"].push_back(parseMs + executeMs + serializeMs);
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            error = ex.what();
+            samples.clear();
+        }
+        return output;
+    }
+
+    std::string runCurrent(const std::string &source, double &parseMs, double &executeMs, double &serializeMs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        Parser parser(source);
+        auto program = parser.parseProgram();
+        parseMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        Interpreter interpreter;
+        interpreter.setThreads(1);
+        interpreter.execute(program.get());
+        executeMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        std::string output = interpreter.getOutput(false);
+        serializeMs = elapsedMs(start);
+        return output;
+    }
+
+    json medians(const PhaseSamples &samples)
+    {
+        json j = json::object();
+        for (auto &entry : samples)
+            j[entry.first + "_ms"] = median(entry.second);
+        return j;
+    }
+
+    json compareWorkload(const Workload &w, const CompareOptions &opts)
+    {
+        PhaseSamples current, legacy;
+        std::string currentError, legacyError;
+
+        std::string currentOut = measure(opts, current, currentError, [&](double &p, double &e, double &s)
+                                         { return runCurrent(w.source, p, e, s); });
+
+        std::string legacySource = legacy_engine::toLegacyDialect(w.source);
+        std::string legacyOut = measure(opts, legacy, legacyError, [&](double &p, double &e, double &s)
+                                        {
+            legacy_engine::Timings t;
+            std::string out = legacy_engine::run(legacySource, t);
+            p = t.parseMs;
+            e = t.executeMs;
+            s = t.serializeMs;
+            return out; });
+
+        json result = {{"name", w.name}, {"params", w.params}};
+        result["current"] = currentError.empty() ? medians(current) : json{{"error", currentError}};
+        result["legacy"] = legacyError.empty() ? medians(legacy) : json{{"error", legacyError}};
+        if (!currentError.empty() || !legacyError.empty())
+        {
+            result["status"] = "error";
+            return result;
+        }
+
+        // Speed ratios 速度比: 旧引擎耗时 / 当前引擎耗时
+        json ratios = json::object();
+        for (auto &entry : current)
+        {
+            double cur = median(entry.second);
+            double old = median(legacy[entry.first]);
+            ratios[entry.first] = cur > 0 ? old / cur : 0.0;
+        }
+        result["speedup"] = ratios;
+
+        // Output diff 输出差异, 以 JSON Patch 形式列出前几处
+        json patch = json::diff(json::parse(currentOut), json::parse(legacyOut));
+        result["status"] = patch.empty() ? "identical" : "different";
+        result["diff_count"] = patch.size();
+        json firstDiffs = json::array();
+        for (size_t i = 0; i < patch.size() && i < MAX_REPORTED_DIFFS; ++i)
+            firstDiffs.push_back(patch[i]);
+        result["diffs"] = firstDiffs;
+        return result;
+    }
+
+    void printSummary(const json &results)
+    {
+        std::cerr << std::fixed << std::setprecision(2);
+        std::cerr << std::setw(20) << "workload" << std::setw(12) << "status" << std::setw(12) << "current ms"
+                  << std::setw(12) << "legacy ms" << std::setw(10) << "speedup" << "\n";
+        for (auto &r : results)
+        {
+            std::cerr << std::setw(20) << r["name"].get<std::string>() << std::setw(12) << r["status"].get<std::string>();
+            if (r.contains("speedup"))
+            {
+                std::cerr << std::setw(12) << r["current"]["total_ms"].get<double>()
+                          << std::setw(12) << r["legacy"]["total_ms"].get<double>()
+                          << std::setw(9) << r["speedup"]["total"].get<double>() << "x";
+            }
+            else
+            {
+                const json &failed = r["current"].contains("error") ? r["current"] : r["legacy"];
+                std::cerr << "  " << (r["current"].contains("error") ? "current: " : "legacy: ")
+                          << failed["error"].get<std::string>();
+            }
+            std::cerr << "\n";
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    CompareOptions opts;
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--runs" && hasValue)
+                opts.runs = std::stoi(argv[++i]);
+            else if (arg == "--warmup" && hasValue)
+                opts.warmup = std::stoi(argv[++i]);
+            else if (arg == "--scale" && hasValue)
+                opts.scale = std::stoi(argv[++i]);
+            else if (arg == "--workload" && hasValue)
+                opts.workloads.push_back(argv[++i]);
+            else if (arg == "--examples" && hasValue)
+                opts.examplesDir = argv[++i];
+            else if (arg == "--output" && hasValue)
+                opts.outputFile = argv[++i];
+            else
+            {
+                std::cerr << "Usage: " << argv[0] << " [--runs <n>] [--warmup <n>] [--scale <n>]"
+                          << " [--workload <name>]... [--examples <dir>] [--output <file.json>]\n";
+                return 1;
+            }
+        }
+        if (opts.runs < 1 || opts.warmup < 0)
+        {
+            std::cerr << "--runs must be at least 1 and --warmup must not be negative" << std::endl;
+            return 1;
+        }
+
+        if (opts.workloads.empty())
+            opts.workloads = workloadNames();
+        std::vector<Workload> workloads;
+        for (auto &name : opts.workloads)
+            workloads.push_back(makeWorkload(name, opts.scale));
+        if (!opts.examplesDir.empty())
+            for (auto &w : loadExamples(opts.examplesDir))
+                workloads.push_back(std::move(w));
+
+        json results = json::array();
+        for (auto &w : workloads)
+            results.push_back(compareWorkload(w, opts));
+        printSummary(results);
+
+        json report = {{"schema_version", SCHEMA_VERSION},
+                       {"runs", opts.runs},
+                       {"warmup", opts.warmup},
+                       {"scale", opts.scale},
+                       {"workloads", results}};
+        if (!opts.outputFile.empty())
+        {
+            std::ofstream ofs(opts.outputFile);
+            if (!ofs)
+            {
+                std::cerr << "Cannot write to " << opts.outputFile << std::endl;
+                return 3;
+            }
+            ofs << report.dump(2) << std::endl;
+            std::cerr << "Report saved to " << opts.outputFile << std::endl;
+        }
+        else
+        {
+            std::cout << report.dump(2) << std::endl;
+        }
+        return 0;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,105 @@
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const double NOT_COUNTED = std::numeric_limits<double>::quiet_NaN();
+
+#ifdef __linux__
+    const std::uint64_t hardwareEvents[PerfCounters::COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                               PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+    int openEvent(std::uint64_t config, int groupFd)
+    {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = groupFd < 0 ? 1 : 0; // 组员跟随组长启用
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+    }
+#endif
+}
+
+PerfCounters::PerfCounters()
+{
+    fds.fill(-1);
+#ifdef __linux__
+    fds[CYCLES] = openEvent(hardwareEvents[CYCLES], -1);
+    if (fds[CYCLES] < 0)
+    {
+        int err = errno;
+        errorMessage = std::string("perf_event_open failed: ") + std::strerror(err);
+        if (err == EACCES || err == EPERM)
+            errorMessage += " (check /proc/sys/kernel/perf_event_paranoid)";
+        return;
+    }
+    for (int c = INSTRUCTIONS; c < COUNT; ++c)
+        fds[c] = openEvent(hardwareEvents[c], fds[CYCLES]);
+#else
+    errorMessage = "perf_event_open is only available on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    // 先关闭组员再关闭组长
+    for (int c = COUNT - 1; c >= 0; --c)
+        if (fds[c] >= 0)
+            close(fds[c]);
+#endif
+}
+
+const char *PerfCounters::name(Counter c)
+{
+    static const char *const names[COUNT] = {"cycles", "instructions", "branch_misses", "cache_misses"};
+    return names[c];
+}
+
+void PerfCounters::start()
+{
+#ifdef __linux__
+    if (!available())
+        return;
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+PerfCounters::Values PerfCounters::stop()
+{
+    Values values;
+    values.fill(NOT_COUNTED);
+#ifdef __linux__
+    if (!available())
+        return values;
+    ioctl(fds[CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int c = 0; c < COUNT; ++c)
+    {
+        if (fds[c] < 0)
+            continue;
+        // value, time_enabled, time_running
+        std::uint64_t data[3] = {};
+        if (read(fds[c], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0)
+            continue;
+        // 计数器被复用时按实际运行时间的比例换算
+        values[c] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+    }
+#endif
+    return values;
+}
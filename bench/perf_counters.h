@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+
+// Hardware performance counters 硬件性能计数器(Linux perf_event_open)
+// 以 cycles 为组长打开一个计数器组, 只统计调用线程的用户态事件.
+// 容器或 perf_event_paranoid 限制导致无法打开时 available() 为 false, 调用方只报告墙钟时间;
+// 单个计数器不受支持(如虚拟机中的 cache-misses)时该项为 NaN
+class PerfCounters
+{
+public:
+    enum Counter
+    {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        CACHE_MISSES,
+        COUNT
+    };
+    using Values = std::array<double, COUNT>;
+
+    PerfCounters(); // 打开失败不抛出异常, 原因见 error()
+    ~PerfCounters();
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    bool available() const { return fds[CYCLES] >= 0; }
+    bool has(Counter c) const { return fds[c] >= 0; }
+    const std::string &error() const { return errorMessage; }
+
+    static const char *name(Counter c); // JSON 中的名称, 如 "branch_misses"
+
+    void start(); // 清零并启用整个计数器组
+    Values stop(); // 停止计数并返回按复用比例换算后的值
+
+private:
+    std::array<int, COUNT> fds;
+    std::string errorMessage;
+};
@@ -0,0 +1,179 @@
+#include "workloads.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+    Workload objectsWorkload(int scale)
+    {
+        const int objects = 200 * scale;
+        const int fields = 20;
+
+        std::ostringstream oss;
+        oss << "// objects: " << objects << " x " << fields << " fields\n";
+        for (int k = 1; k <= objects; ++k)
+        {
+            oss << "obj(\"Item\", " << k << ") {\n";
+            for (int f = 1; f <= fields; ++f)
+            {
+                if (f % 2)
+                    oss << "    num(f" << f << ") { " << k << " * " << f << " + " << f << " }\n";
+                else
+                    oss << "    str(f" << f << ") { \"item_" << f << "_\" + " << k << " }\n";
+            }
+            oss << "}\n";
+        }
+        return {"objects", {{"objects", objects}, {"fields", fields}}, oss.str()};
+    }
+
+    Workload exprWorkload(int scale)
+    {
+        const int objects = 100 * scale;
+        const int depth = 64;
+
+        // 左结合的深层嵌套: ((((i + 1) * 2) % 1009) - 3) ...
+        static const char *ops[] = {"+", "*", "%", "-"};
+        std::string e = "i";
+        for (int d = 0; d < depth; ++d)
+        {
+            const char *op = ops[d % 4];
+            std::string rhs = op[0] == '%' ? "1009" : std::to_string(d % 7 + 1);
+            e = "(" + e + " " + op + " " + rhs + ")";
+        }
+
+        std::ostringstream oss;
+        oss << "// expr: depth " << depth << "\n";
+        oss << "for(i, " << objects << ") {\n";
+        oss << "    obj(\"Expr\", i) {\n";
+        oss << "        num(v) { " << e << " }\n";
+        oss << "        bool(big) { v > 500 && v % 2 == 0 || v < 10 }\n";
+        oss << "    }\n";
+        oss << "}\n";
+        return {"expr", {{"objects", objects}, {"depth", depth}}, oss.str()};
+    }
+
+    Workload loopWorkload(int scale)
+    {
+        const int outer = 100 * scale;
+        const int inner = 100;
+
+        std::ostringstream oss;
+        oss << "// loop: " << outer << " x " << inner << " iterations\n";
+        oss << "num(acc) { 0 }\n";
+        oss << "num(odd) { 0 }\n";
+        oss << "for(i, " << outer << ") {\n";
+        oss << "    for(j, " << inner << ") {\n";
+        oss << "        acc = acc + (i * j) % 7\n";
+        oss << "        if(j % 2 == 1) {\n";
+        oss << "            odd = odd + 1\n";
+        oss << "        }\n";
+        oss << "    }\n";
+        oss << "}\n";
+        oss << "obj(\"Result\", 1) {\n";
+        oss << "    num(total) { acc }\n";
+        oss << "    num(odd_count) { odd }\n";
+        oss << "}\n";
+        return {"loop", {{"outer", outer}, {"inner", inner}}, oss.str()};
+    }
+
+    Workload concatWorkload(int scale)
+    {
+        const int objects = 100 * scale;
+        const int pieces = 50;
+
+        std::ostringstream oss;
+        oss << "// concat: " << objects << " objects x " << pieces << " pieces\n";
+        oss << "for(i, " << objects << ") {\n";
+        oss << "    obj(\"Text\", i) {\n";
+        oss << "        str(s) { \"\" }\n";
+        oss << "        for(j, " << pieces << ") {\n";
+        oss << "            s = s + \"piece_\" + j + \";\"\n";
+        oss << "        }\n";
+        oss << "    }\n";
+        oss << "}\n";
+        return {"concat", {{"objects", objects}, {"pieces", pieces}}, oss.str()};
+    }
+
+    Workload commentsWorkload(int scale)
+    {
+        const int objects = 100 * scale;
+        const int fields = 8;
+
+        // 深缩进、空行和整行注释占大部分字节, 主要压测空白和注释的跳过
+        const std::string indent(16, ' ');
+        std::ostringstream oss;
+        oss << "// comments: " << objects << " objects x " << fields << " commented fields\n";
+        for (int k = 1; k <= objects; ++k)
+        {
+            oss << "// ------------------------------------------------------------------------\n";
+            oss << "// Item " << k << ": generated card with documented fields\n";
+            oss << "// ------------------------------------------------------------------------\n";
+            oss << "obj(\"Item\", " << k << ") {\n";
+            for (int f = 1; f <= fields; ++f)
+            {
+                oss << "\n";
+                oss << indent << "// field f" << f << ": value derived from the item id and field index\n";
+                oss << indent << "// (kept in sync with the card database schema)\n";
+                oss << indent << "num(f" << f << ") {\n";
+                oss << indent << indent << k << " * " << f << "\n";
+                oss << indent << "}\n";
+            }
+            oss << "}\n\n";
+        }
+        return {"comments", {{"objects", objects}, {"fields", fields}}, oss.str()};
+    }
+}
+
+const std::vector<std::string> &workloadNames()
+{
+    static const std::vector<std::string> names = {"objects", "expr", "loop", "concat", "comments"};
+    return names;
+}
+
+Workload makeWorkload(const std::string &name, int scale)
+{
+    if (scale < 1)
+        throw std::runtime_error("Workload scale must be at least 1");
+    if (name == "objects")
+        return objectsWorkload(scale);
+    if (name == "expr")
+        return exprWorkload(scale);
+    if (name == "loop")
+        return loopWorkload(scale);
+    if (name == "concat")
+        return concatWorkload(scale);
+    if (name == "comments")
+        return commentsWorkload(scale);
+    throw std::runtime_error("Unknown workload: " + name);
+}
+
+std::string readFile(const std::string &path)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("Cannot open " + path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return ss.str();
+}
+
+std::vector<Workload> loadExamples(const std::string &dir)
+{
+    std::vector<std::filesystem::path> files;
+    for (auto &entry : std::filesystem::directory_iterator(dir))
+        if (entry.is_regular_file() && entry.path().extension() == ".gen")
+            files.push_back(entry.path());
+    std::sort(files.begin(), files.end());
+
+    std::vector<Workload> result;
+    for (auto &file : files)
+    {
+        result.push_back({"example/" + file.stem().string(),
+                          {{"file", file.filename().string()}},
+                          readFile(file.string())});
+    }
+    return result;
+}
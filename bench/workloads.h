@@ -0,0 +1,31 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Synthetic benchmark script 合成基准脚本
+struct Workload
+{
+    std::string name;
+    json params;        // 生成参数, 原样写入报告
+    std::string source; // 脚本源代码
+};
+
+// Available workload names 可用的负载名称
+// objects: N 个顶层对象 × M 个字段, 主要压测词法和语法分析
+// expr:    嵌套深度为 D 的表达式
+// loop:    嵌套循环中的累加, 只产生一个对象
+// concat:  对象内循环拼接字符串
+// comments: 以缩进、空行和注释为主的脚本, 主要压测词法分析
+const std::vector<std::string> &workloadNames();
+
+// scale 按比例放大对象数或迭代次数
+Workload makeWorkload(const std::string &name, int scale);
+
+// 目录中的 *.gen 脚本按文件名排序, 作为名为 example/<stem> 的负载
+std::vector<Workload> loadExamples(const std::string &dir);
+
+std::string readFile(const std::string &path);
@@ -0,0 +1,32 @@
+# 运行示例脚本并与 examples/out 中的期望输出比较
+# 参数: LUDUSCRIPT, SCRIPT, EXPECTED, ACTUAL, 可选 ARGS(额外命令行参数),
+#       可选 EXPECT_ERROR(正则表达式, 设置时脚本必须失败且错误信息匹配, 不比较输出)
+
+get_filename_component(actual_dir ${ACTUAL} DIRECTORY)
+file(MAKE_DIRECTORY ${actual_dir})
+
+execute_process(
+    COMMAND ${LUDUSCRIPT} ${SCRIPT} --pretty --output ${ACTUAL} ${ARGS}
+    RESULT_VARIABLE run_result
+    ERROR_VARIABLE run_stderr
+)
+if(DEFINED EXPECT_ERROR)
+    if(run_result EQUAL 0)
+        message(FATAL_ERROR "luduscript succeeded on ${SCRIPT}, expected an error matching '${EXPECT_ERROR}'")
+    endif()
+    if(NOT run_stderr MATCHES "${EXPECT_ERROR}")
+        message(FATAL_ERROR "Error from ${SCRIPT} does not match '${EXPECT_ERROR}':\n${run_stderr}")
+    endif()
+    return()
+endif()
+if(NOT run_result EQUAL 0)
+    message(FATAL_ERROR "luduscript failed on ${SCRIPT} (exit code ${run_result}):\n${run_stderr}")
+endif()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files --ignore-eol ${ACTUAL} ${EXPECTED}
+    RESULT_VARIABLE compare_result
+)
+if(NOT compare_result EQUAL 0)
+    message(FATAL_ERROR "Output of ${SCRIPT} differs from ${EXPECTED}")
+endif()
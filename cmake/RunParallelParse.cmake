@@ -0,0 +1,74 @@
+# 并行解析回归测试: 生成超过 1 MiB 的脚本, 分别用 1 个和 4 个线程运行, 输出和错误信息必须相同
+# 脚本片段包含字符串和注释中的大括号、'}' 之后的 elif/else、跨行字符串和转义的引号,
+# 这些都是查找顶层语句边界时容易出错的地方
+# 参数: LUDUSCRIPT, WORK_DIR
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(chunk [=[
+// comment with braces { { } and an "unterminated quote
+str(s_open) { "{ not a block" }
+str(s_close) { "} also not {{ a block" }
+str(s_multi) { "line one {
+line two }
+line three" }
+str(s_esc) { "quote \" { brace" }
+num(n) { 0 }
+if(n == 1) {
+    n = 2
+}
+// comment between } and elif
+elif(n == 0) {
+    n = 3
+} else {
+    n = 4
+}
+for(k, 1, 2) {
+    obj("Chunk", k) {
+        str(a) { s_open }
+        str(b) { s_close + s_multi }
+        str(c) { s_esc }
+        num(v) { n * k }
+    }
+}
+]=])
+
+# 约 1.3 MiB, --threads 4 时切成 4 个片段
+string(REPEAT "${chunk}" 2500 body)
+file(WRITE ${WORK_DIR}/large.gen "${body}")
+# 最后一条语句出错, 报告的行号依赖各片段的起始行号
+file(WRITE ${WORK_DIR}/large_error.gen "${body}undefined_fn(1)\n")
+
+foreach(threads 1 4)
+    execute_process(
+        COMMAND ${LUDUSCRIPT} ${WORK_DIR}/large.gen --threads ${threads} --output ${WORK_DIR}/large_${threads}.json
+        RESULT_VARIABLE run_result
+        ERROR_VARIABLE run_stderr
+        OUTPUT_QUIET
+    )
+    if(NOT run_result EQUAL 0)
+        message(FATAL_ERROR "luduscript failed on large.gen with --threads ${threads}:\n${run_stderr}")
+    endif()
+
+    execute_process(
+        COMMAND ${LUDUSCRIPT} ${WORK_DIR}/large_error.gen --threads ${threads}
+        RESULT_VARIABLE error_result
+        ERROR_VARIABLE error_stderr_${threads}
+        OUTPUT_QUIET
+    )
+    if(error_result EQUAL 0 OR NOT error_stderr_${threads} MATCHES "Runtime error \\(line [0-9]+\\)")
+        message(FATAL_ERROR "Expected a runtime error with a line number from large_error.gen (--threads ${threads}):\n${error_stderr_${threads}}")
+    endif()
+endforeach()
+
+execute_process(
+    COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/large_1.json ${WORK_DIR}/large_4.json
+    RESULT_VARIABLE compare_result
+)
+if(NOT compare_result EQUAL 0)
+    message(FATAL_ERROR "Parallel parse output differs from sequential parse output")
+endif()
+
+if(NOT error_stderr_1 STREQUAL error_stderr_4)
+    message(FATAL_ERROR "Parallel parse reports a different error:\n  sequential: ${error_stderr_1}  parallel:   ${error_stderr_4}")
+endif()
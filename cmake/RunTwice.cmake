@@ -0,0 +1,64 @@
+# 两次运行同一示例脚本, 检查第一次运行保存的状态(编译缓存、前导段快照)能被第二次运行使用
+# 两次的输出都需与 examples/out 中的期望结果一致
+# 参数: LUDUSCRIPT, SCRIPT, EXPECTED, ACTUAL, ARGS(额外命令行参数),
+#       STATE(状态文件或目录, 第一次运行前删除),
+#       可选 CORRUPT(为真时在两次运行之间用无效数据覆盖 STATE 中的文件),
+#       可选 FLIP_TOOL 和 FLIP_TEXT(在两次运行之间用 luduscript_flip_byte 改动 STATE 文件中 FLIP_TEXT 的一个字节),
+#       可选 PHASES / NO_PHASES(第二次运行的 --stats 中必须出现 / 不能出现的阶段名)
+
+get_filename_component(actual_dir ${ACTUAL} DIRECTORY)
+file(MAKE_DIRECTORY ${actual_dir})
+file(REMOVE_RECURSE ${STATE})
+
+foreach(run 1 2)
+    if(run EQUAL 2 AND (CORRUPT OR FLIP_TEXT))
+        if(IS_DIRECTORY ${STATE})
+            file(GLOB state_files ${STATE}/*)
+        else()
+            set(state_files ${STATE})
+        endif()
+        if(NOT state_files)
+            message(FATAL_ERROR "First run of ${SCRIPT} did not write ${STATE}")
+        endif()
+        foreach(f ${state_files})
+            if(FLIP_TEXT)
+                execute_process(COMMAND ${FLIP_TOOL} ${f} ${FLIP_TEXT} RESULT_VARIABLE flip_result)
+                if(NOT flip_result EQUAL 0)
+                    message(FATAL_ERROR "Cannot flip '${FLIP_TEXT}' in ${f}")
+                endif()
+            else()
+                file(WRITE ${f} "LDSC damaged state")
+            endif()
+        endforeach()
+    endif()
+
+    execute_process(
+        COMMAND ${LUDUSCRIPT} ${SCRIPT} --pretty --output ${ACTUAL} --stats ${ARGS}
+        RESULT_VARIABLE run_result
+        ERROR_VARIABLE run_stderr
+        OUTPUT_QUIET
+    )
+    if(NOT run_result EQUAL 0)
+        message(FATAL_ERROR "luduscript failed on ${SCRIPT} (run ${run}, exit code ${run_result}):\n${run_stderr}")
+    endif()
+
+    execute_process(
+        COMMAND ${CMAKE_COMMAND} -E compare_files --ignore-eol ${ACTUAL} ${EXPECTED}
+        RESULT_VARIABLE compare_result
+    )
+    if(NOT compare_result EQUAL 0)
+        message(FATAL_ERROR "Output of ${SCRIPT} (run ${run}) differs from ${EXPECTED}")
+    endif()
+endforeach()
+
+# --stats 的 JSON 中每个阶段以 "名称": 出现
+foreach(phase ${PHASES})
+    if(NOT run_stderr MATCHES "\"${phase}\":")
+        message(FATAL_ERROR "Second run of ${SCRIPT} has no '${phase}' phase:\n${run_stderr}")
+    endif()
+endforeach()
+foreach(phase ${NO_PHASES})
+    if(run_stderr MATCHES "\"${phase}\":")
+        message(FATAL_ERROR "Second run of ${SCRIPT} unexpectedly ran '${phase}':\n${run_stderr}")
+    endif()
+endforeach()
@@ -0,0 +1,44 @@
+#pragma once
+
+// Allocation accounting 内存分配统计
+// 使用 -DLUDUSCRIPT_ALLOC_STATS=ON 构建时替换全局 operator new/delete,
+// 按当前所处的阶段统计分配次数和字节数, 程序退出时向 stderr 打印表格.
+// 未开启时 ALLOC_PHASE 为空操作, 没有任何开销
+
+enum class AllocPhase
+{
+    OTHER,
+    LEX,        // 词法分析: Token 字符串
+    PARSE,      // 语法分析: AST 节点
+    EXECUTE,    // 执行中未归入以下类别的分配
+    SCOPE,      // 作用域压栈/出栈和变量表
+    VALUE_COPY, // Value 复制
+    JSON_BUILD, // 构建输出对象
+    SERIALIZE,  // 输出序列化
+    COUNT
+};
+
+#ifdef LUDUSCRIPT_ALLOC_STATS
+
+// 在作用域内把当前线程的分配归入指定阶段, 嵌套时内层优先
+class AllocPhaseScope
+{
+public:
+    explicit AllocPhaseScope(AllocPhase p);
+    ~AllocPhaseScope();
+    AllocPhaseScope(const AllocPhaseScope &) = delete;
+    AllocPhaseScope &operator=(const AllocPhaseScope &) = delete;
+
+private:
+    AllocPhase prev;
+};
+
+#define ALLOC_PHASE_CONCAT_(a, b) a##b
+#define ALLOC_PHASE_NAME_(line) ALLOC_PHASE_CONCAT_(allocPhaseScope_, line)
+#define ALLOC_PHASE(p) AllocPhaseScope ALLOC_PHASE_NAME_(__LINE__)(AllocPhase::p)
+
+#else
+
+#define ALLOC_PHASE(p) ((void)0)
+
+#endif
@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <optional>
+#include <functional>
 
 using ll = long long;
 
@@ -85,6 +86,22 @@ struct CallExpr : Expr
     CallExpr(ExprPtr c, std::vector<ExprPtr> a, int l);
 };
 
+// Array literal expressions 数组字面量表达式([元素, ...])
+struct ArrayExpr : Expr
+{
+    std::vector<ExprPtr> elems;
+    ArrayExpr(std::vector<ExprPtr> e, int l);
+};
+
+// Index expressions 下标表达式(目标数组 + 下标)
+struct IndexExpr : Expr
+{
+    ExprPtr target;
+    ExprPtr index;
+    bool checked = true; // 循环范围已证明下标合法时为 false, 跳过越界检查
+    IndexExpr(ExprPtr t, ExprPtr i, int l);
+};
+
 // Member access expressions 成员访问表达式(目标对象 + 成员名) TODO 这个似乎解释器还不支持
 struct AccessExpr : Expr
 {
@@ -120,7 +137,7 @@ struct AssignStmt : Stmt
 // 声明语句(类型 + 变量名 + 初始化语句块)
 struct DeclStmt : Stmt
 {
-    std::string type; // "num", "str", "bool"
+    std::string type; // "num", "str", "bool", "arr"
     std::string name;
     std::optional<ExprPtr> init;
     std::vector<StmtPtr> initBlock; // For statement block initialization
@@ -141,21 +158,49 @@ struct IfStmt : Stmt
 // For statement 循环语句(迭代变量 + 迭代范围 + 语句块)
 struct ForStmt : Stmt
 {
+    // Extra dimension of a product loop 笛卡尔积循环的后续维度
+    struct Dim
+    {
+        std::string iter;
+        std::vector<ExprPtr> args;
+    };
+
     std::string iter;
     std::vector<ExprPtr> args; // 1~3 args: total or start,end or start,end,step
+    std::vector<Dim> dims;     // for(a, 1, 4; b, 1, 13) 中 b 及之后的维度
     std::vector<StmtPtr> body;
     ForStmt(std::string it, int l);
 };
 
-// Object statement 对象语句(类名 + 可选的对象ID + 语句块)
+// Object statement 对象语句(类名 + 可选的对象ID + 可选的原型名 + 语句块)
 struct ObjStmt : Stmt
 {
     std::string className;
     ExprPtr idExpr;
+    std::string proto; // obj("Card", id) : proto_name {}, 为空表示不使用原型
     std::vector<StmtPtr> body;
     ObjStmt(std::string c, ExprPtr id, int l);
 };
 
+// Prototype statement 原型语句(原型名 + 可选的父原型名 + 语句块)
+// 原型的字段只在定义时求值一次, 使用原型的对象直接复制这些字段
+struct ProtoStmt : Stmt
+{
+    std::string name;
+    std::string parent;
+    std::vector<StmtPtr> body;
+    ProtoStmt(std::string n, int l);
+};
+
+// Function definition 函数定义(函数名 + 形参列表 + 语句块)
+struct FnStmt : Stmt
+{
+    std::string name;
+    std::vector<std::string> params;
+    std::vector<StmtPtr> body; // 最后一个表达式的值作为返回值
+    FnStmt(std::string n, std::vector<std::string> p, int l);
+};
+
 // Break statement 跳出语句
 struct BreakStmt : Stmt
 {
@@ -168,4 +213,12 @@ struct ContinueStmt : Stmt
 {
     std::vector<StmtPtr> body; // 继续时执行的语句块
     ContinueStmt(std::vector<StmtPtr> b, int l);
-};
\ No newline at end of file
+};
+
+// Builtin function names 内置函数名
+bool isBuiltinFunction(const std::string &name);
+
+// Visit direct children of a node 遍历节点的直接子节点
+void forEachChild(Node *n, const std::function<void(Node *)> &f);
+// Number of nodes in the subtree rooted at n 子树节点数(含 n)
+size_t countNodes(Node *n);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ast.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// Compiled script cache 编译后脚本的磁盘缓存
+// 把解析(含下标检查消除等分析)后的 Program 序列化为紧凑的二进制格式: 字符串表 + 节点标签 + 变长整数(行号存差值).
+// 缓存文件名由引擎版本和源代码的 FNV-1a 哈希决定; 文件头再次记录引擎版本、源代码长度和哈希, 以及正文的哈希.
+// 读取时通过 mmap 映射, 任何不匹配或损坏都视为未命中, 由调用方重新解析并覆盖
+
+// 引擎版本: 项目版本 + AST 格式版本, 任一变化都会使旧缓存失效
+const std::string &engineVersion();
+
+std::uint64_t fnv1a64(std::string_view data, std::uint64_t seed = 0xcbf29ce484222325ull);
+
+std::string serializeProgram(const Program &program, std::string_view source);
+// 数据损坏或与 source/引擎版本不匹配时抛出 std::runtime_error
+std::unique_ptr<Program> deserializeProgram(std::string_view data, std::string_view source);
+
+// 先写临时文件再改名, 并发运行不会读到写了一半的文件; 失败时返回 false
+bool writeFileAtomic(const std::string &path, std::string_view data);
+
+class ScriptCache
+{
+public:
+    explicit ScriptCache(std::string dir);
+
+    std::string pathFor(std::string_view source) const;
+    // 未命中或缓存无效时返回 nullptr
+    std::unique_ptr<Program> load(std::string_view source) const;
+    // 失败时返回 false
+    bool store(std::string_view source, const Program &program) const;
+
+private:
+    std::string dir;
+};
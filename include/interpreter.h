@@ -9,10 +9,18 @@
 
 using json = nlohmann::json;
 
+class Profiler;
+class Tracer;
+class NodeStats;
+class ScriptStack;
+class Parser;
+
 // Loop control exceptions
 struct BreakException : std::exception {};
 struct ContinueException : std::exception {};
 
+struct Array;
+
 // Value type for runtime values
 struct Value
 {
@@ -20,24 +28,63 @@ struct Value
     {
         NUM,
         STR,
-        BOOL
+        BOOL,
+        ARR
     } type;
     
     double nval;  // Numeric value (can represent both int and float)
     bool isInteger; // Flag to indicate if the number should be treated as integer
     std::string sval;
     bool bval;
+    std::shared_ptr<const Array> aval; // Arrays are immutable and shared between copies
+    
+#ifdef LUDUSCRIPT_ALLOC_STATS
+    // 分配统计构建中, 复制产生的分配归入 value copy 阶段
+    Value() = default;
+    Value(const Value &o);
+    Value &operator=(const Value &o);
+    Value(Value &&) = default;
+    Value &operator=(Value &&) = default;
+#endif
     
     static Value makeInt(ll i);
     static Value makeNum(double n);
     static Value makeStr(std::string s);
     static Value makeBool(bool b);
+    static Value makeArr(std::shared_ptr<const Array> a);
+    static Value fromJson(const json &j);
     
     std::string toStr() const;
     double toNum() const;
     ll toInt() const;
     bool toBool() const;
     bool isInt() const; // Check if this numeric value should be treated as integer
+    json toJson() const;
+};
+
+// Array value 数组, 元素按类型连续存储
+struct Array
+{
+    enum class Elem
+    {
+        NUM,
+        STR
+    } elem = Elem::NUM;
+    
+    bool isInteger = true; // 数字数组的元素是否全为整数
+    std::vector<double> nums;
+    std::vector<std::string> strs;
+    
+    size_t size() const;
+    Value at(size_t i) const; // No bounds check
+    bool operator==(const Array &o) const;
+};
+
+// Object prototype 对象原型, 字段已预先求值
+struct Prototype
+{
+    json fields = json::object();
+    std::unordered_set<std::string> names; // 字段名, 复制到 declared_fields
 };
 
 // Runtime environment
@@ -51,11 +98,41 @@ struct Env
     std::unordered_set<std::string> declared_fields;
     // Output array
     json output = json::array();
+    // Defined prototypes
+    std::unordered_map<std::string, Prototype> prototypes;
     
     void pushScope();
     void popScope();
     void setVar(const std::string &k, const Value &v);
     std::optional<Value> getVar(const std::string &k);
+    const Prototype &getPrototype(const std::string &name) const;
+};
+
+// User-defined function 用户自定义函数
+struct Function
+{
+    FnStmt *decl = nullptr;
+    bool pure = false; // 无副作用且只依赖实参, 调用结果按实参元组缓存
+    std::unordered_map<std::string, Value> memo;
+};
+
+// Range of one loop dimension 单个循环维度的范围
+struct LoopRange
+{
+    ll start = 1;
+    ll step = 1;
+    ll count = 0; // 迭代次数
+};
+
+// Flat iteration space of a (product) for loop 循环的扁平迭代空间
+// 扁平下标 k 按行优先分解为各维坐标, 最后一维变化最快
+struct IterSpace
+{
+    std::vector<LoopRange> ranges;
+    ll total = 1;
+    
+    ll value(size_t dim, ll coord) const;
+    void coords(ll k, std::vector<ll> &out) const; // 各维迭代变量的值
 };
 
 // Interpreter class
@@ -63,27 +140,92 @@ class Interpreter
 {
 private:
     Env env;
+    // Defined functions 已定义的函数
+    std::unordered_map<std::string, Function> functions;
+    int callDepth = 0;
+    std::uintptr_t callStackBase = 0; // 最外层函数调用处的栈地址, 用于限制递归占用的栈空间
+    unsigned threads = 0; // 并行循环的线程数, 0 表示使用硬件线程数
+    Profiler *profiler = nullptr;
+    Tracer *tracer = nullptr;
+    unsigned traceTid = 0; // 时间线中的线程编号, 0 为主线程
+    ll objsSeen = 0;       // 对象采样计数
+    NodeStats *nodeStats = nullptr;
+    ScriptStack *scriptStack = nullptr; // 供采样剖析器读取的脚本调用栈
+    std::vector<StmtPtr> retainedStmts; // 流式执行中定义了函数的顶层语句, functions 引用其中的 FnStmt
     
     // Expression evaluation
     Value evalExpr(Expr *e);
+    Value dispatchExpr(Expr *e);
     Value evalLiteral(LiteralExpr *lit);
     Value evalIdent(IdentExpr *id);
     Value evalUnary(UnaryExpr *u);
     Value evalBinary(BinaryExpr *b);
     Value evalCall(CallExpr *c);
+    Value evalArray(ArrayExpr *a);
+    Value evalIndex(IndexExpr *ix);
+    Value callBuiltin(const std::string &name, const std::vector<Value> &args);
     Value evalAccess(AccessExpr *a);
     
     // Statement execution
     void execStmt(Stmt *s);
+    void execTopLevel(Stmt *s);
+    void dispatchStmt(Stmt *s);
     void execBlock(const std::vector<StmtPtr> &body);
     
     // Helper functions for return values
     Value execIfWithReturn(IfStmt *is);
     Value execBlockWithReturn(const std::vector<StmtPtr> &body);
     
+    // Loops
+    void execFor(ForStmt *fs);
+    LoopRange evalRange(const std::vector<ExprPtr> &args);
+    IterSpace evalIterSpace(ForStmt *fs);
+    void setIterVars(ForStmt *fs, const IterSpace &space, ll k, std::vector<ll> &coords);
+    bool isParallelizable(ForStmt *fs) const;
+    bool onlyBuildsObjects(Stmt *s, const std::unordered_set<std::string> &iters) const;
+    static std::unordered_set<std::string> iterNames(ForStmt *fs);
+    void execForParallel(ForStmt *fs, const IterSpace &space, unsigned workers);
+    
+    // User-defined functions
+    void defineFunction(FnStmt *fn);
+    bool isPure(FnStmt *fn) const;
+    Value callFunction(Function &fn, const std::vector<Value> &args);
+    
 public:
     Interpreter() = default;
     
+    void setThreads(unsigned n);
+    void setProfiler(Profiler *p);
+    void setTracer(Tracer *t);
+    void setNodeStats(NodeStats *s);
+    void setScriptStack(ScriptStack *s);
     void execute(Program *program);
+    void executeIndex(Program *program, ll index, size_t first = 0); // 只生成第 index 个对象(从 0 开始), 从第 first 条顶层语句开始执行
+    void executeRange(Program *program, size_t begin, size_t end);  // 执行第 [begin, end) 条顶层语句
+    // 流式执行: 解析线程逐条产生顶层语句, 当前线程执行后立即释放其 AST(定义函数的语句除外),
+    // AST 占用的内存只取决于最大的一条语句. 报告文件中第一个出错的语句(解析错误或运行错误).
+    // 不能与剖析、时间线、节点统计和采样同时使用, 它们在执行结束后仍引用 AST. 返回执行过的 AST 节点数
+    size_t executeStream(Parser &parser);
+    
+    // Prelude snapshot 前导段快照(interpreter_snapshot.cpp)
+    // 前导段是开头不含 obj 语句的顶层语句: 全局变量、查找表计算、函数和原型定义.
+    // 快照保存前导段执行后的变量、原型、函数和已有输出, 以源代码哈希和引擎版本校验,
+    // 正文另存哈希, 载入时先校验再解码
+    static size_t preludeLength(const Program *program);
+    std::string saveSnapshot(const Program *program, std::string_view source) const;
+    // 快照损坏或与 source/引擎版本不匹配时抛出 std::runtime_error, 此时解释器状态不变
+    void loadSnapshot(std::string_view data, Program *program, std::string_view source);
+    // --param: 文本按整数、小数、true/false 或字符串解析后赋给全局变量; 变量已存在时类型必须相同
+    void setParam(const std::string &name, const std::string &text);
+    
+    // Warm state 前导段执行后的解释器状态, 同一脚本的后续执行复制它而不必重新执行前导段
+    struct State
+    {
+        Env env;
+        std::unordered_map<std::string, Function> functions;
+    };
+    State captureState() const;
+    void restoreState(const State &state);
     std::string getOutput(bool pretty = false) const;
+    size_t objectCount() const;
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <vector>
 
 enum class TokenKind
@@ -19,9 +22,12 @@ enum class TokenKind
     KW_BREAK,
     KW_CONTINUE,
     KW_OBJ,
+    KW_FN,
+    KW_PROTO,
     KW_NUM,
     KW_STR,
     KW_BOOL,
+    KW_ARR,
     KW_TRUE,
     KW_FALSE,
     // 符号
@@ -29,7 +35,10 @@ enum class TokenKind
     RPAREN,
     LBRACE,
     RBRACE,
+    LBRACKET,
+    RBRACKET,
     COMMA,
+    COLON,
     SEMI,
     DOT,
     // 运算符
@@ -51,27 +60,63 @@ enum class TokenKind
     UNKNOWN
 };
 
+// text 指向源代码或词法分析器中保存的转义字符串, 不复制 token 文本;
+// 因此 Token 不能比源代码和产生它的 Lexer 存活得更久
 struct Token
 {
     TokenKind kind;
-    std::string text;
+    std::string_view text;
     int line;
 
-    Token(TokenKind k = TokenKind::UNKNOWN, std::string t = "", int l = 1);
+    Token(TokenKind k = TokenKind::UNKNOWN, std::string_view t = {}, int l = 1);
 };
 
+// Structure-of-arrays token buffer 整个文件的 token 数组
+// 每个 token 只保存 kind/offset/length/line 四个定长字段, 文本指向源代码;
+// 含转义字符的字符串解码后追加到 extra, 其 offset 带有 EXTRA_BIT.
+// 最后一个 token 总是 END, 越界访问返回该 END
+class TokenBuffer
+{
+public:
+    size_t size() const { return kinds.size(); }
+    TokenKind kind(size_t i) const { return static_cast<TokenKind>(kinds[clamp(i)]); }
+    int line(size_t i) const { return lines[clamp(i)]; }
+    std::string_view text(size_t i) const;
+    Token operator[](size_t i) const { return Token(kind(i), text(i), line(i)); }
+
+private:
+    friend class Lexer;
+    static constexpr std::uint32_t EXTRA_BIT = 1u << 31;
+
+    std::string_view src;
+    std::string extra;
+    std::vector<std::uint8_t> kinds;
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> lengths;
+    std::vector<std::int32_t> lines;
+
+    size_t clamp(size_t i) const { return i < kinds.size() ? i : kinds.size() - 1; }
+    void push(const Token &t);
+};
+
+// 词法分析器不拥有源代码(可以是 mmap 映射的文件), 调用方保证其在分析期间有效
 class Lexer
 {
 private:
-    std::string src;
+    std::string_view src;
     size_t i = 0;
     int line = 1;
+    std::deque<std::string> unescaped; // 含转义字符的字符串字面量的解码结果, 地址保持不变
 
     char peek() const;
     char get();
     void skipWhitespace();
+    std::string_view slice(size_t start) const;
 
 public:
-    explicit Lexer(std::string s);
+    explicit Lexer(std::string_view s, int firstLine = 1);
+    Lexer(const Lexer &) = delete; // 复制会使指向 unescaped 的 token 失效
+    Lexer &operator=(const Lexer &) = delete;
     Token nextToken();
+    TokenBuffer tokenizeAll(); // 从当前位置分析到文件末尾(包含 END)
 };
\ No newline at end of file
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Bulk character scanning for the lexer 词法分析器的批量扫描
+// x86 上用 SSE2 一次比较 16 字节, CPU 支持 AVX2 时(运行时检测)一次比较 32 字节; 其他平台使用逐字节实现.
+// 所有实现的结果完全相同
+
+// 从 i 开始跳过空格、制表符、'\r' 和 '\n', 返回第一个其他字符的位置(没有时返回 n);
+// 跳过的换行数累加到 newlines
+size_t scanBlank(const char *s, size_t i, size_t n, int &newlines);
+
+// 返回从 i 开始第一个 '\n' 的位置, 没有时返回 n
+size_t scanNewline(const char *s, size_t i, size_t n);
+
+// 当前使用的实现: "avx2", "sse2" 或 "scalar"
+const char *scanImplementation();
+
+// 强制使用指定实现(基准测试对比用); 当前 CPU 不支持时抛出 std::runtime_error
+void setScanImplementation(const std::string &name);
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ast.h"
+#include "profiler.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// AST node execution histogram 按节点种类统计的执行次数和耗时
+// 种类细分到运算符、声明方式等(如 "BinaryExpr +", "DeclStmt num init").
+// 每个种类每 sampleEvery 次执行计时一次, 总耗时按采样平均值估算, 包含子节点的时间
+class NodeStats
+{
+public:
+    class Scope
+    {
+    public:
+        Scope(NodeStats &s, Node *n) : s(s), kind(s.kindOf(n))
+        {
+            Kind &k = s.kinds[kind];
+            sampled = k.count++ % s.sampleEvery == 0;
+            if (sampled)
+                start = profileTicks();
+        }
+        ~Scope()
+        {
+            if (sampled)
+            {
+                Kind &k = s.kinds[kind];
+                k.sampledTicks += profileTicks() - start;
+                ++k.samples;
+            }
+        }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        NodeStats &s;
+        size_t kind;
+        bool sampled;
+        std::uint64_t start = 0;
+    };
+
+    explicit NodeStats(std::uint64_t sampleEvery = 16);
+
+    std::string report() const;
+
+private:
+    struct Kind
+    {
+        std::string name;
+        std::uint64_t count = 0;
+        std::uint64_t samples = 0;
+        std::uint64_t sampledTicks = 0;
+    };
+
+    std::vector<Kind> kinds;
+    std::unordered_map<std::string, size_t> kindIds;
+    std::unordered_map<const Node *, size_t> nodeKinds; // 每个节点的种类只计算一次
+    std::uint64_t sampleEvery;
+    TickClock clock;
+
+    size_t kindOf(const Node *n);
+    static std::string kindName(const Node *n);
+};
@@ -8,11 +8,34 @@
 
 class Parser
 {
+public:
+    // 最大嵌套深度: 语句、一元运算和括号每层计 1, 左结合的运算符链和调用/下标链每个运算符计 1.
+    // 解析器和之后遍历 AST 的代码(执行、分析、编译缓存)都是递归的, 超出时报错而不是耗尽栈空间
+    static constexpr int MAX_NESTING_DEPTH = 256;
+
 private:
-    Lexer lex;
+    TokenBuffer tokens; // 构造时一次性完成词法分析
+    size_t pos = 0;     // cur 在 tokens 中的下标
     Token cur;
+    int depth = 0;      // 当前嵌套深度
+
+    // Nesting guard 嵌套深度计数, 析构时归还本作用域中 enter() 增加的深度
+    class Nesting
+    {
+    public:
+        explicit Nesting(Parser &p) : p(p) {}
+        ~Nesting() { p.depth -= levels; }
+        Nesting(const Nesting &) = delete;
+        Nesting &operator=(const Nesting &) = delete;
+        void enter();
+
+    private:
+        Parser &p;
+        int levels = 0;
+    };
     
     Token peek();
+    Token peekNext();
     Token consume();
     bool match(TokenKind k);
     void expect(TokenKind k, const std::string &msg);
@@ -30,16 +53,33 @@ private:
     ExprPtr parseUnary();
     ExprPtr parsePrimary();
     ExprPtr parseCall(ExprPtr callee);
+    ExprPtr parseArray();
     
     // Statement parsing
     StmtPtr parseStmt();
     StmtPtr parseIf();
     StmtPtr parseFor();
     StmtPtr parseObj();
+    StmtPtr parseFn();
+    StmtPtr parseProto();
+    std::string parseProtoRef();
     StmtPtr parseDecl();
     std::vector<StmtPtr> parseBlock();
     
 public:
-    explicit Parser(std::string src);
+    // src 必须在 Parser 析构之前保持有效; 生成的 AST 复制了需要的文本, 不引用 src.
+    // firstLine 为 src 第一行的行号(解析脚本片段时使用)
+    explicit Parser(std::string_view src, int firstLine = 1);
     std::unique_ptr<Program> parseProgram();
-};
\ No newline at end of file
+    StmtPtr parseNextStmt(); // 解析下一条顶层语句, 到达文件末尾时返回 nullptr
+};
+
+// Index check elimination 下标越界检查消除: for 语句的循环体解析完成后调用.
+// 从编译缓存载入的 AST 也重新分析, 不信任文件中的标记
+void markUncheckedIndexes(ForStmt *fs);
+
+// Parse a whole script, in parallel when it is large 解析整个脚本
+// 超过 1 MiB 且 threads != 1 时, 先按大括号深度找出顶层语句的边界(跳过字符串和注释),
+// 把脚本切成若干片段在多个线程上分别解析, 再按顺序拼接为一个 Program, 行号与顺序解析一致.
+// 任一片段出错时退回顺序解析, 保证报告的错误与顺序解析相同. threads 为 0 时使用硬件线程数
+std::unique_ptr<Program> parseProgram(std::string_view src, unsigned threads);
\ No newline at end of file
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+// Low-overhead timestamp 低开销时间戳
+// x86 上读取 TSC, 其他平台使用 steady_clock 纳秒数
+std::uint64_t profileTicks();
+
+// Converts profileTicks() differences to wall time 时间戳频率校准
+// 以构造时刻为起点, 对照 steady_clock 计算每毫秒的时间戳数
+class TickClock
+{
+public:
+    TickClock();
+    std::uint64_t startTicks() const { return start; }
+    double ticksPerMs() const;
+
+private:
+    std::uint64_t start;
+    std::uint64_t startNanos;
+};
+
+// Per-line execution profiler 按源代码行统计的执行剖析器
+// 记录每行语句的执行次数、包含时间(含子语句)和独占时间(不含子语句), 以及每个对象类的同类统计
+class Profiler
+{
+public:
+    struct Stat
+    {
+        std::uint64_t count = 0;
+        std::uint64_t inclusive = 0; // ticks
+        std::uint64_t exclusive = 0; // ticks
+    };
+
+    // RAII guard for one statement execution
+    class Scope
+    {
+    public:
+        Scope(Profiler &p, int line, const std::string *objClass) : p(p) { p.enter(line, objClass); }
+        ~Scope() { p.exit(); }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Profiler &p;
+    };
+
+    Profiler();
+
+    void enter(int line, const std::string *objClass);
+    void exit();
+    void finish(); // 停止计时并校准时间戳频率
+
+    std::string report(std::string_view source, size_t top = 20) const;
+    json toJson(std::string_view source) const;
+
+private:
+    struct Frame
+    {
+        int line;
+        const std::string *objClass;
+        std::uint64_t start;
+        std::uint64_t children;
+    };
+
+    std::vector<Frame> stack;
+    std::vector<Stat> lines; // 下标为行号
+    std::vector<int> activeLines; // 递归时只统计最外层的包含时间
+    std::unordered_map<std::string, Stat> classes;
+    std::unordered_map<std::string, int> activeClasses;
+
+    TickClock clock;
+    std::uint64_t totalTicks = 0;
+    double ticksPerMs = 1e6;
+
+    double ms(std::uint64_t ticks) const;
+};
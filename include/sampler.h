@@ -0,0 +1,85 @@
+#pragma once
+
+#include "ast.h"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Script call stack 脚本调用栈
+// 解释器执行语句和调用函数时压入对应的 AST 节点, 采样信号处理函数只读取这个栈.
+// 超过 MAX_DEPTH 的部分不记录, 只保留外层
+class ScriptStack
+{
+public:
+    static constexpr int MAX_DEPTH = 32;
+
+    void push(const Node *n)
+    {
+        int d = depth.load(std::memory_order_relaxed);
+        if (d < MAX_DEPTH)
+            frames[d] = n;
+        std::atomic_signal_fence(std::memory_order_release);
+        depth.store(d + 1, std::memory_order_relaxed);
+    }
+    void pop()
+    {
+        depth.store(depth.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+    }
+
+    // RAII guard for one frame
+    class Frame
+    {
+    public:
+        Frame(ScriptStack &s, const Node *n) : s(s) { s.push(n); }
+        ~Frame() { s.pop(); }
+        Frame(const Frame &) = delete;
+        Frame &operator=(const Frame &) = delete;
+
+    private:
+        ScriptStack &s;
+    };
+
+private:
+    friend class Sampler;
+    const Node *frames[MAX_DEPTH] = {};
+    std::atomic<int> depth{0};
+};
+
+// SIGPROF sampling profiler 基于 SIGPROF/setitimer 的采样剖析器(仅 POSIX)
+// 按进程 CPU 时间定时采样脚本调用栈, 样本写入预分配的缓冲区, 结束后输出 Brendan Gregg 折叠栈格式
+class Sampler
+{
+public:
+    explicit Sampler(ScriptStack &stack, size_t capacity = 1 << 14);
+    ~Sampler();
+
+    static bool supported();
+
+    void start(int hz); // 不支持的平台抛出 std::runtime_error
+    void stop();
+
+    // root 为每个栈的最外层帧名(一般为脚本文件名)
+    void writeFolded(std::ostream &os, const std::string &root) const;
+
+    size_t sampleCount() const;
+    size_t dropped() const { return droppedCount.load(); }
+
+private:
+    struct Sample
+    {
+        int depth;
+        const Node *frames[ScriptStack::MAX_DEPTH];
+    };
+
+    ScriptStack &stack;
+    std::vector<Sample> samples;
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> droppedCount{0};
+    bool running = false;
+
+    static void onSignal(int);
+    void takeSample();
+    static std::string frameName(const Node *n);
+};
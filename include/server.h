@@ -0,0 +1,150 @@
+#pragma once
+
+#include "ast.h"
+#include "interpreter.h"
+#include "nlohmann/json.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Compiled script 编译后的脚本: AST 和执行前导段后的解释器状态
+// 两者在执行期间都只读, 每个请求复制 prelude 后从第 first 条顶层语句开始执行
+struct CompiledScript
+{
+    std::shared_ptr<Program> program;
+    size_t first = 0; // 前导段长度
+    Interpreter::State prelude;
+};
+
+// Compiled program cache 编译后脚本的 LRU 缓存, 以源代码内容哈希为键.
+// FNV-1a 不抗碰撞, 条目保存源代码全文, 命中时逐字节比较, 构造的碰撞源代码不会取到其他脚本的 Program
+// 取出的 shared_ptr 可以在多个工作线程中同时执行, 被淘汰后由最后一个使用者释放
+class ProgramCache
+{
+public:
+    explicit ProgramCache(size_t capacity);
+
+    // 未命中时返回 nullptr
+    std::shared_ptr<const CompiledScript> get(std::string_view source);
+    void put(std::string_view source, std::shared_ptr<const CompiledScript> script);
+    size_t size() const;
+
+private:
+    struct Entry
+    {
+        std::uint64_t key;
+        std::string source;
+        std::shared_ptr<const CompiledScript> script;
+    };
+
+    size_t capacity;
+    mutable std::mutex mutex;
+    std::list<Entry> entries; // 最近使用的在前
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+};
+
+// Request latency window 最近请求的延迟, 用于计算百分位数
+class LatencyStats
+{
+public:
+    explicit LatencyStats(size_t window = 4096);
+
+    void record(double ms, bool ok, bool cacheHit);
+    json toJson() const;
+
+private:
+    size_t window;
+    mutable std::mutex mutex;
+    std::vector<double> samples; // 环形缓冲区
+    size_t next = 0;
+    std::uint64_t requests = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t cacheHits = 0;
+    std::uint64_t cacheMisses = 0;
+};
+
+// Resident daemon 常驻服务(--serve, 仅 POSIX)
+// 在 Unix 域套接字上接受连接. poll 线程监视所有空闲连接, 收到数据的连接交给工作线程池,
+// 工作线程处理一个请求后把连接交还 poll 线程, 因此保持打开的空闲连接不占用工作线程; 同一连接上的请求按顺序执行.
+// 脚本首次执行时编译并执行前导段, 之后的请求复制前导段执行后的状态, 只执行剩余的语句.
+// --prefork N 时改为多进程: 父进程预先编译 preload 中的脚本并执行前导段, 再 fork 出 N 个单线程的
+// 工作进程, 它们以写时复制方式继承这些状态, 在同一个套接字上各自接受连接, 并在自己的 poll 循环中轮流处理这些连接的请求;
+// 工作进程异常退出时由父进程延迟补充, 连续崩溃时延迟逐次加长; 短时间内崩溃过多时结束所有工作进程并以错误退出.
+// 各工作进程的缓存和统计相互独立, stats 响应中的 pid 标明来源.
+// 每个请求是一行 JSON:
+//   {"script": "path"} 或 {"source": "..."}, 可选 "params": {"name": value}, "index": k, "format": "json" | "pretty"
+//   {"cmd": "stats"}     请求数、错误数、缓存命中数和最近请求的延迟百分位数
+//   {"cmd": "shutdown"}  处理完进行中的请求后退出(多进程模式下立即结束所有工作进程)
+// 成功时先返回一行头部 {"ok": true, "bytes": N, ...}, 之后是 N 字节的 JSON 正文;
+// 失败时只返回一行 {"ok": false, "error": "..."}
+class Server
+{
+public:
+    struct Options
+    {
+        std::string socketPath;
+        unsigned workers = 0;     // 0 表示使用硬件线程数
+        size_t cacheCapacity = 64; // 缓存的 Program 数
+        unsigned threads = 1;     // 每个请求中并行循环的线程数
+        unsigned prefork = 0;     // 工作进程数, 0 表示使用线程池
+        std::vector<std::string> preload; // 启动时编译并执行前导段的脚本
+    };
+
+    explicit Server(Options opts);
+    ~Server();
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+    static bool supported();
+
+    // 阻塞直到收到 shutdown 请求; 无法监听套接字或平台不支持时抛出 std::runtime_error
+    void run();
+
+private:
+    Options opts;
+    ProgramCache cache;
+    LatencyStats stats;
+    int listenFd = -1;
+    std::atomic<bool> stopping{false};
+
+    // Client connection 客户端连接的读缓冲区, 只由当前持有该连接的线程访问
+    struct Connection
+    {
+        std::string buffer;
+        size_t scanned = 0; // buffer 中已确认不含换行的前缀长度
+    };
+
+    std::mutex mutex;
+    std::condition_variable pending;
+    std::unordered_map<int, Connection> connections; // 所有打开的连接
+    std::unordered_set<int> idle;                    // 等待客户端数据的连接, 由 poll 线程监视
+    std::deque<int> ready;                           // 有数据可读或缓冲区中有完整请求的连接
+    int wakeFds[2] = {-1, -1};                       // 连接交还或停止时唤醒 poll 线程
+
+    void eventLoop(bool inlineRequests); // inlineRequests: 在 poll 线程中处理请求(多进程模式的工作进程)
+    void workerLoop();
+    bool runPrefork(); // 父进程: 启动并看护工作进程, 直到收到 SIGTERM/SIGINT 或 shutdown 请求; 因崩溃过多放弃时返回 false
+    void childLoop();  // 工作进程: 在单线程的 poll 循环中处理连接
+    std::shared_ptr<const CompiledScript> compile(std::string_view source);
+    // 处理就绪连接上的一个请求, 之后放回就绪队列(缓冲区中还有完整请求)、交还 poll 线程或关闭连接
+    void serveReady(int fd);
+    bool serveRequest(int fd, Connection &conn); // 连接应关闭时返回 false
+    // 处理一个请求, 返回完整的响应(头部行 + 正文); 收到 shutdown 请求时置 shutdown 为 true
+    std::string handle(const std::string &line, bool &shutdown);
+    // 执行脚本, 返回输出 JSON, 对象数和缓存是否命中写入 header
+    std::string runScript(const json &req, json &header);
+    void stop();
+    void openWakePipe();
+    void wake();
+    void closeConnections();
+};
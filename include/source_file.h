@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only script source 只读的脚本源代码
+// POSIX 系统上普通文件通过 mmap 只读映射, 不复制到 std::string;
+// 管道等无法映射的文件以及其他平台退回到一次性读入内存.
+// view() 在对象析构前一直有效, Lexer/Parser 直接引用其中的文本
+class SourceFile
+{
+public:
+    explicit SourceFile(const std::string &path); // 无法打开时抛出 std::runtime_error
+    ~SourceFile();
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+
+    std::string_view view() const { return {data, size}; }
+    bool mapped() const { return mappedData != nullptr; }
+
+private:
+    const char *data = nullptr;
+    size_t size = 0;
+    void *mappedData = nullptr;
+    std::string buffer; // 未映射时的内容
+
+    void readAll(const std::string &path);
+};
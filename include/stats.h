@@ -0,0 +1,54 @@
+#pragma once
+
+#include "nlohmann/json.hpp"
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+// Run statistics 运行统计: 各阶段的墙钟时间和 CPU 时间, 以及吞吐量和内存峰值
+class RunStats
+{
+public:
+    struct Phase
+    {
+        std::string name;
+        double wallMs;
+        double cpuMs; // 进程所有线程的 CPU 时间
+    };
+
+    // RAII guard timing one phase
+    class Scope
+    {
+    public:
+        Scope(RunStats &s, const char *name)
+            : s(s), name(name), wall(std::chrono::steady_clock::now()), cpu(std::clock()) {}
+        ~Scope();
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        RunStats &s;
+        const char *name;
+        std::chrono::steady_clock::time_point wall;
+        std::clock_t cpu;
+    };
+
+    std::vector<Phase> phases;
+    std::uint64_t astNodes = 0;
+    std::uint64_t objects = 0;
+    std::uint64_t bytesWritten = 0;
+    long long peakRssKb = -1;
+
+    // Peak resident set size in KiB, -1 if unavailable 内存峰值(KiB), 不支持时为 -1
+    static long long readPeakRssKb();
+
+    std::string report() const;
+    json toJson() const;
+
+private:
+    double totalWallMs() const;
+};
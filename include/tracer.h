@@ -0,0 +1,85 @@
+#pragma once
+
+#include "profiler.h"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Chrome trace-event recorder Chrome/Perfetto 时间线记录器
+// 事件写入预分配的缓冲区, 记录时不分配内存. 阶段、顶层语句和并行分块的事件写入单独的保留区,
+// 数量再多的采样 obj 事件也不会挤掉它们. 缓冲区写满后丢弃新事件而不是覆盖旧事件, 计入 dropped(),
+// 因此解析阶段和开头的事件总能保留.
+// 多个线程可以同时记录, 每个线程使用不同的 tid; 每个事件领取一个独占的槽位, 写完后发布
+class Tracer
+{
+public:
+    struct Event
+    {
+        const char *name = nullptr;          // 静态字符串
+        const std::string *detail = nullptr; // 指向 AST 中的字符串, 输出前 AST 必须存活
+        int line = 0;                        // 0 表示没有源代码行
+        unsigned tid = 0;
+        std::uint64_t begin = 0;
+        std::uint64_t end = 0;
+    };
+
+    // RAII guard recording one complete event
+    class Scope
+    {
+    public:
+        Scope(Tracer &t, const char *name, const std::string *detail = nullptr, int line = 0, unsigned tid = 0,
+              bool sampled = false)
+            : t(t), name(name), detail(detail), line(line), tid(tid), sampled(sampled), begin(profileTicks()) {}
+        ~Scope() { t.record(name, detail, line, tid, begin, profileTicks(), sampled); }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Tracer &t;
+        const char *name;
+        const std::string *detail;
+        int line;
+        unsigned tid;
+        bool sampled;
+        std::uint64_t begin;
+    };
+
+    // capacity: 采样事件的槽位数; reserved: 阶段、顶层语句等结构事件的槽位数
+    explicit Tracer(size_t capacity = 1 << 16, long long objSample = 1, size_t reserved = 1 << 12);
+
+    // sampled 为真的事件(按 objSample 采样的 obj)写入采样区, 其余写入保留区
+    void record(const char *name, const std::string *detail, int line, unsigned tid,
+                std::uint64_t begin, std::uint64_t end, bool sampled = false);
+
+    // 每 objSample 个对象记录一个
+    bool sampleObj(long long seen) const { return seen % objSample == 0; }
+
+    // 因缓冲区已满而丢弃的事件数
+    size_t dropped() const;
+
+    // {"traceEvents": [...]}, 时间单位为微秒
+    json toJson() const;
+
+private:
+    // 第 k 个事件写入第 k 个槽位, 超出容量的事件丢弃; ready 在事件写完后置位
+    struct Slot
+    {
+        std::atomic<bool> ready{false};
+        Event event;
+    };
+    struct Buffer
+    {
+        explicit Buffer(size_t capacity) : slots(capacity) {}
+        std::vector<Slot> slots;
+        std::atomic<std::uint64_t> next{0};
+    };
+
+    static void append(Buffer &buffer, const Event &e);
+    static size_t overflow(const Buffer &buffer);
+
+    Buffer structure;
+    Buffer samples;
+    long long objSample;
+    TickClock clock;
+};
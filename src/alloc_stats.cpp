@@ -0,0 +1,138 @@
+#include "alloc_stats.h"
+
+#ifdef LUDUSCRIPT_ALLOC_STATS
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    constexpr size_t PHASE_COUNT = static_cast<size_t>(AllocPhase::COUNT);
+
+    const char *const phaseNames[PHASE_COUNT] = {"other", "lex", "parse", "execute", "scope",
+                                                 "value copy", "json build", "serialize"};
+
+    struct Counters
+    {
+        std::atomic<std::uint64_t> allocs{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> frees{0};
+    };
+
+    Counters counters[PHASE_COUNT];
+    thread_local AllocPhase currentPhase = AllocPhase::OTHER;
+
+    void *countedAlloc(std::size_t size)
+    {
+        Counters &c = counters[static_cast<size_t>(currentPhase)];
+        c.allocs.fetch_add(1, std::memory_order_relaxed);
+        c.bytes.fetch_add(size, std::memory_order_relaxed);
+        return std::malloc(size ? size : 1);
+    }
+
+    void countedFree(void *p)
+    {
+        if (!p)
+            return;
+        counters[static_cast<size_t>(currentPhase)].frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(p);
+    }
+
+    // 静态析构时打印, 只使用 stdio 避免再次分配内存
+    struct Reporter
+    {
+        ~Reporter()
+        {
+            std::uint64_t totalAllocs = 0, totalBytes = 0;
+            for (auto &c : counters)
+            {
+                totalAllocs += c.allocs.load();
+                totalBytes += c.bytes.load();
+            }
+            std::fprintf(stderr, "Allocations by phase\n%12s %12s %14s %12s %10s %7s\n",
+                         "phase", "allocs", "bytes", "frees", "avg B", "alloc%");
+            for (size_t i = 0; i < PHASE_COUNT; ++i)
+            {
+                std::uint64_t allocs = counters[i].allocs.load();
+                std::uint64_t bytes = counters[i].bytes.load();
+                std::fprintf(stderr, "%12s %12llu %14llu %12llu %10.1f %6.1f%%\n", phaseNames[i],
+                             static_cast<unsigned long long>(allocs), static_cast<unsigned long long>(bytes),
+                             static_cast<unsigned long long>(counters[i].frees.load()),
+                             allocs ? static_cast<double>(bytes) / static_cast<double>(allocs) : 0.0,
+                             totalAllocs ? 100.0 * static_cast<double>(allocs) / static_cast<double>(totalAllocs) : 0.0);
+            }
+            std::fprintf(stderr, "%12s %12llu %14llu\n", "total", static_cast<unsigned long long>(totalAllocs),
+                         static_cast<unsigned long long>(totalBytes));
+        }
+    } reporter;
+}
+
+AllocPhaseScope::AllocPhaseScope(AllocPhase p) : prev(currentPhase)
+{
+    currentPhase = p;
+}
+
+AllocPhaseScope::~AllocPhaseScope()
+{
+    currentPhase = prev;
+}
+
+// Replacement global allocation functions 替换全局分配函数
+void *operator new(std::size_t size)
+{
+    if (void *p = countedAlloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    if (void *p = countedAlloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+#endif
@@ -18,6 +18,12 @@ BinaryExpr::BinaryExpr(ExprPtr l, std::string o, ExprPtr r, int ln) : Expr(ln),
 // CallExpr constructor
 CallExpr::CallExpr(ExprPtr c, std::vector<ExprPtr> a, int l) : Expr(l), callee(std::move(c)), args(std::move(a)) {}
 
+// ArrayExpr constructor
+ArrayExpr::ArrayExpr(std::vector<ExprPtr> e, int l) : Expr(l), elems(std::move(e)) {}
+
+// IndexExpr constructor
+IndexExpr::IndexExpr(ExprPtr t, ExprPtr i, int l) : Expr(l), target(std::move(t)), index(std::move(i)) {}
+
 // AccessExpr constructor
 AccessExpr::AccessExpr(ExprPtr t, std::string m, int l) : Expr(l), target(std::move(t)), member(std::move(m)) {}
 
@@ -43,6 +49,104 @@ ForStmt::ForStmt(std::string it, int l) : Stmt(l), iter(std::move(it)) {}
 // ObjStmt constructor
 ObjStmt::ObjStmt(std::string c, ExprPtr id, int l) : Stmt(l), className(std::move(c)), idExpr(std::move(id)) {}
 
+// ProtoStmt constructor
+ProtoStmt::ProtoStmt(std::string n, int l) : Stmt(l), name(std::move(n)) {}
+
+// FnStmt constructor
+FnStmt::FnStmt(std::string n, std::vector<std::string> p, int l) : Stmt(l), name(std::move(n)), params(std::move(p)) {}
+
 BreakStmt::BreakStmt(std::vector<StmtPtr> b, int l) : Stmt(l), body(std::move(b)) {}
 
-ContinueStmt::ContinueStmt(std::vector<StmtPtr> b, int l) : Stmt(l), body(std::move(b)) {}
\ No newline at end of file
+ContinueStmt::ContinueStmt(std::vector<StmtPtr> b, int l) : Stmt(l), body(std::move(b)) {}
+
+bool isBuiltinFunction(const std::string &name)
+{
+    return name == "len";
+}
+
+void forEachChild(Node *n, const std::function<void(Node *)> &f)
+{
+    auto each = [&](const std::vector<StmtPtr> &body)
+    {
+        for (auto &st : body)
+            f(st.get());
+    };
+
+    if (auto p = dynamic_cast<Program *>(n))
+        each(p->stmts);
+    else if (auto u = dynamic_cast<UnaryExpr *>(n))
+        f(u->rhs.get());
+    else if (auto b = dynamic_cast<BinaryExpr *>(n))
+    {
+        f(b->lhs.get());
+        f(b->rhs.get());
+    }
+    else if (auto c = dynamic_cast<CallExpr *>(n))
+    {
+        f(c->callee.get());
+        for (auto &a : c->args)
+            f(a.get());
+    }
+    else if (auto arr = dynamic_cast<ArrayExpr *>(n))
+    {
+        for (auto &e : arr->elems)
+            f(e.get());
+    }
+    else if (auto ix = dynamic_cast<IndexExpr *>(n))
+    {
+        f(ix->target.get());
+        f(ix->index.get());
+    }
+    else if (auto a = dynamic_cast<AccessExpr *>(n))
+        f(a->target.get());
+    else if (auto es = dynamic_cast<ExprStmt *>(n))
+        f(es->expr.get());
+    else if (auto as = dynamic_cast<AssignStmt *>(n))
+        f(as->expr.get());
+    else if (auto ds = dynamic_cast<DeclStmt *>(n))
+    {
+        if (ds->init.has_value())
+            f(ds->init->get());
+        each(ds->initBlock);
+    }
+    else if (auto is = dynamic_cast<IfStmt *>(n))
+    {
+        f(is->cond.get());
+        each(is->thenBody);
+        for (auto &elif : is->elifs)
+        {
+            f(elif.first.get());
+            each(elif.second);
+        }
+        each(is->elseBody);
+    }
+    else if (auto fs = dynamic_cast<ForStmt *>(n))
+    {
+        for (auto &a : fs->args)
+            f(a.get());
+        for (auto &dim : fs->dims)
+            for (auto &a : dim.args)
+                f(a.get());
+        each(fs->body);
+    }
+    else if (auto os = dynamic_cast<ObjStmt *>(n))
+    {
+        f(os->idExpr.get());
+        each(os->body);
+    }
+    else if (auto ps = dynamic_cast<ProtoStmt *>(n))
+        each(ps->body);
+    else if (auto fn = dynamic_cast<FnStmt *>(n))
+        each(fn->body);
+    else if (auto bs = dynamic_cast<BreakStmt *>(n))
+        each(bs->body);
+    else if (auto cs = dynamic_cast<ContinueStmt *>(n))
+        each(cs->body);
+}
+size_t countNodes(Node *n)
+{
+    size_t count = 1;
+    forEachChild(n, [&](Node *child)
+                 { count += countNodes(child); });
+    return count;
+}
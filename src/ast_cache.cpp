@@ -0,0 +1,655 @@
+#include "ast_cache.h"
+#include "parser.h"
+#include "source_file.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <unordered_map>
+
+#ifndef LUDUSCRIPT_VERSION
+#define LUDUSCRIPT_VERSION "dev"
+#endif
+
+namespace
+{
+    constexpr char MAGIC[4] = {'L', 'D', 'S', 'C'};
+    // AST 或编码方式变化时递增
+    constexpr int AST_FORMAT_VERSION = 4;
+
+    enum class Tag : std::uint8_t
+    {
+        NONE, // 空表达式(如 obj 省略的 id)
+        LIT_INT,
+        LIT_FLOAT,
+        LIT_STRING,
+        LIT_BOOL,
+        IDENT,
+        UNARY,
+        BINARY,
+        CALL,
+        ARRAY,
+        INDEX,
+        ACCESS,
+        EXPR_STMT,
+        ASSIGN,
+        DECL,
+        IF,
+        FOR,
+        OBJ,
+        PROTO,
+        FN,
+        BREAK,
+        CONTINUE,
+    };
+
+    // 节点中的字符串(标识符、运算符、类名等大量重复)写入字符串表, 节点只保存下标;
+    // 行号保存为与上一个节点的差值
+    class Writer
+    {
+    public:
+        std::string out;
+        std::vector<std::string_view> strings;
+        std::unordered_map<std::string_view, size_t> stringIds;
+        int lastLine = 0;
+
+        void u8(std::uint8_t v) { out.push_back(static_cast<char>(v)); }
+        void varint(std::uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                u8(static_cast<std::uint8_t>(v | 0x80));
+                v >>= 7;
+            }
+            u8(static_cast<std::uint8_t>(v));
+        }
+        void sint(ll v) { varint((static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63)); }
+        void f64(double d)
+        {
+            char buf[sizeof(double)];
+            std::memcpy(buf, &d, sizeof(d));
+            out.append(buf, sizeof(buf));
+        }
+        void bytes(std::string_view s)
+        {
+            varint(s.size());
+            out.append(s);
+        }
+        void str(const std::string &s)
+        {
+            auto it = stringIds.find(s);
+            if (it == stringIds.end())
+            {
+                it = stringIds.emplace(s, strings.size()).first;
+                strings.push_back(s);
+            }
+            varint(it->second);
+        }
+        void tag(Tag t, const Node *n)
+        {
+            u8(static_cast<std::uint8_t>(t));
+            sint(static_cast<ll>(n->line) - lastLine);
+            lastLine = n->line;
+        }
+
+        void expr(const Expr *e);
+        void exprs(const std::vector<ExprPtr> &v)
+        {
+            varint(v.size());
+            for (auto &e : v)
+                expr(e.get());
+        }
+        void stmt(const Stmt *s);
+        void block(const std::vector<StmtPtr> &v)
+        {
+            varint(v.size());
+            for (auto &s : v)
+                stmt(s.get());
+        }
+    };
+
+    void Writer::expr(const Expr *e)
+    {
+        if (!e)
+        {
+            u8(static_cast<std::uint8_t>(Tag::NONE));
+            return;
+        }
+        if (auto lit = dynamic_cast<const LiteralExpr *>(e))
+        {
+            switch (lit->kind)
+            {
+            case LiteralExpr::Kind::INTEGER:
+                tag(Tag::LIT_INT, e);
+                sint(lit->ival);
+                break;
+            case LiteralExpr::Kind::FLOAT:
+                tag(Tag::LIT_FLOAT, e);
+                f64(lit->dval);
+                break;
+            case LiteralExpr::Kind::STRING:
+                tag(Tag::LIT_STRING, e);
+                str(lit->sval);
+                break;
+            case LiteralExpr::Kind::BOOL:
+                tag(Tag::LIT_BOOL, e);
+                u8(lit->bval ? 1 : 0);
+                break;
+            }
+        }
+        else if (auto id = dynamic_cast<const IdentExpr *>(e))
+        {
+            tag(Tag::IDENT, e);
+            str(id->name);
+        }
+        else if (auto u = dynamic_cast<const UnaryExpr *>(e))
+        {
+            tag(Tag::UNARY, e);
+            str(u->op);
+            expr(u->rhs.get());
+        }
+        else if (auto b = dynamic_cast<const BinaryExpr *>(e))
+        {
+            tag(Tag::BINARY, e);
+            str(b->op);
+            expr(b->lhs.get());
+            expr(b->rhs.get());
+        }
+        else if (auto c = dynamic_cast<const CallExpr *>(e))
+        {
+            tag(Tag::CALL, e);
+            expr(c->callee.get());
+            exprs(c->args);
+        }
+        else if (auto a = dynamic_cast<const ArrayExpr *>(e))
+        {
+            tag(Tag::ARRAY, e);
+            exprs(a->elems);
+        }
+        else if (auto ix = dynamic_cast<const IndexExpr *>(e))
+        {
+            tag(Tag::INDEX, e);
+            expr(ix->target.get());
+            expr(ix->index.get());
+        }
+        else if (auto ac = dynamic_cast<const AccessExpr *>(e))
+        {
+            tag(Tag::ACCESS, e);
+            str(ac->member);
+            expr(ac->target.get());
+        }
+        else
+        {
+            throw std::runtime_error("Cannot serialize unknown expression node");
+        }
+    }
+
+    void Writer::stmt(const Stmt *s)
+    {
+        if (auto es = dynamic_cast<const ExprStmt *>(s))
+        {
+            tag(Tag::EXPR_STMT, s);
+            expr(es->expr.get());
+        }
+        else if (auto as = dynamic_cast<const AssignStmt *>(s))
+        {
+            tag(Tag::ASSIGN, s);
+            str(as->name);
+            expr(as->expr.get());
+        }
+        else if (auto ds = dynamic_cast<const DeclStmt *>(s))
+        {
+            tag(Tag::DECL, s);
+            str(ds->type);
+            str(ds->name);
+            u8(ds->init.has_value() ? 1 : 0);
+            if (ds->init.has_value())
+                expr(ds->init->get());
+            block(ds->initBlock);
+        }
+        else if (auto is = dynamic_cast<const IfStmt *>(s))
+        {
+            tag(Tag::IF, s);
+            expr(is->cond.get());
+            block(is->thenBody);
+            varint(is->elifs.size());
+            for (auto &elif : is->elifs)
+            {
+                expr(elif.first.get());
+                block(elif.second);
+            }
+            block(is->elseBody);
+        }
+        else if (auto fs = dynamic_cast<const ForStmt *>(s))
+        {
+            tag(Tag::FOR, s);
+            str(fs->iter);
+            exprs(fs->args);
+            varint(fs->dims.size());
+            for (auto &dim : fs->dims)
+            {
+                str(dim.iter);
+                exprs(dim.args);
+            }
+            block(fs->body);
+        }
+        else if (auto os = dynamic_cast<const ObjStmt *>(s))
+        {
+            tag(Tag::OBJ, s);
+            str(os->className);
+            expr(os->idExpr.get());
+            str(os->proto);
+            block(os->body);
+        }
+        else if (auto ps = dynamic_cast<const ProtoStmt *>(s))
+        {
+            tag(Tag::PROTO, s);
+            str(ps->name);
+            str(ps->parent);
+            block(ps->body);
+        }
+        else if (auto fn = dynamic_cast<const FnStmt *>(s))
+        {
+            tag(Tag::FN, s);
+            str(fn->name);
+            varint(fn->params.size());
+            for (auto &p : fn->params)
+                str(p);
+            block(fn->body);
+        }
+        else if (auto bs = dynamic_cast<const BreakStmt *>(s))
+        {
+            tag(Tag::BREAK, s);
+            block(bs->body);
+        }
+        else if (auto cs = dynamic_cast<const ContinueStmt *>(s))
+        {
+            tag(Tag::CONTINUE, s);
+            block(cs->body);
+        }
+        else
+        {
+            throw std::runtime_error("Cannot serialize unknown statement node");
+        }
+    }
+
+    // 所有读取都检查边界, 只有可省略的字段(obj 的 id、声明的初始值)接受空表达式, 损坏的缓存只会导致异常.
+    // 影响运行时安全的分析结果(下标检查消除)不保存, 载入后重新计算
+    class Reader
+    {
+    public:
+        explicit Reader(std::string_view data) : data(data) {}
+
+        std::uint8_t u8()
+        {
+            need(1);
+            return static_cast<std::uint8_t>(data[pos++]);
+        }
+        std::uint64_t varint()
+        {
+            std::uint64_t v = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                std::uint8_t b = u8();
+                v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+                if (!(b & 0x80))
+                    return v;
+            }
+            corrupt();
+        }
+        ll sint()
+        {
+            std::uint64_t v = varint();
+            return static_cast<ll>((v >> 1) ^ (~(v & 1) + 1));
+        }
+        double f64()
+        {
+            need(sizeof(double));
+            double d;
+            std::memcpy(&d, data.data() + pos, sizeof(d));
+            pos += sizeof(d);
+            return d;
+        }
+        std::string_view bytes()
+        {
+            return raw(count());
+        }
+        void readStrings()
+        {
+            strings.resize(count());
+            for (auto &s : strings)
+                s = bytes();
+        }
+        std::string str()
+        {
+            std::uint64_t id = varint();
+            if (id >= strings.size())
+                corrupt();
+            return std::string(strings[id]);
+        }
+        std::string_view raw(size_t n)
+        {
+            need(n);
+            std::string_view v = data.substr(pos, n);
+            pos += n;
+            return v;
+        }
+        // 元素个数不可能超过剩余字节数
+        size_t count()
+        {
+            std::uint64_t n = varint();
+            if (n > data.size() - pos)
+                corrupt();
+            return static_cast<size_t>(n);
+        }
+        bool atEnd() const { return pos == data.size(); }
+        std::string_view rest() const { return data.substr(pos); }
+
+        ExprPtr expr();
+        std::vector<ExprPtr> exprs()
+        {
+            std::vector<ExprPtr> v(count());
+            for (auto &e : v)
+                e = required();
+            return v;
+        }
+        StmtPtr stmt();
+        std::vector<StmtPtr> block()
+        {
+            std::vector<StmtPtr> v(count());
+            for (auto &s : v)
+                s = stmt();
+            return v;
+        }
+
+        [[noreturn]] static void corrupt()
+        {
+            throw std::runtime_error("Corrupt script cache");
+        }
+
+    private:
+        std::string_view data;
+        size_t pos = 0;
+        std::vector<std::string_view> strings;
+        int lastLine = 0;
+
+        void need(size_t n)
+        {
+            if (n > data.size() - pos)
+                corrupt();
+        }
+        int line()
+        {
+            lastLine = static_cast<int>(lastLine + sint());
+            return lastLine;
+        }
+        ExprPtr required()
+        {
+            ExprPtr e = expr();
+            if (!e)
+                corrupt();
+            return e;
+        }
+    };
+
+    ExprPtr Reader::expr()
+    {
+        Tag t = static_cast<Tag>(u8());
+        if (t == Tag::NONE)
+            return nullptr;
+        int l = line();
+        switch (t)
+        {
+        case Tag::LIT_INT:
+            return std::make_unique<LiteralExpr>(static_cast<ll>(sint()), l);
+        case Tag::LIT_FLOAT:
+            return std::make_unique<LiteralExpr>(f64(), l);
+        case Tag::LIT_STRING:
+            return std::make_unique<LiteralExpr>(str(), l);
+        case Tag::LIT_BOOL:
+            return std::make_unique<LiteralExpr>(u8() != 0, l);
+        case Tag::IDENT:
+            return std::make_unique<IdentExpr>(str(), l);
+        case Tag::UNARY:
+        {
+            std::string op = str();
+            return std::make_unique<UnaryExpr>(std::move(op), required(), l);
+        }
+        case Tag::BINARY:
+        {
+            std::string op = str();
+            ExprPtr lhs = required();
+            ExprPtr rhs = required();
+            return std::make_unique<BinaryExpr>(std::move(lhs), std::move(op), std::move(rhs), l);
+        }
+        case Tag::CALL:
+        {
+            ExprPtr callee = required();
+            return std::make_unique<CallExpr>(std::move(callee), exprs(), l);
+        }
+        case Tag::ARRAY:
+            return std::make_unique<ArrayExpr>(exprs(), l);
+        case Tag::INDEX:
+        {
+            ExprPtr target = required();
+            ExprPtr index = required();
+            return std::make_unique<IndexExpr>(std::move(target), std::move(index), l);
+        }
+        case Tag::ACCESS:
+        {
+            std::string member = str();
+            return std::make_unique<AccessExpr>(required(), std::move(member), l);
+        }
+        default:
+            corrupt();
+        }
+    }
+
+    StmtPtr Reader::stmt()
+    {
+        Tag t = static_cast<Tag>(u8());
+        int l = line();
+        switch (t)
+        {
+        case Tag::EXPR_STMT:
+            return std::make_unique<ExprStmt>(required(), l);
+        case Tag::ASSIGN:
+        {
+            std::string name = str();
+            return std::make_unique<AssignStmt>(std::move(name), required(), l);
+        }
+        case Tag::DECL:
+        {
+            std::string type = str();
+            std::string name = str();
+            std::optional<ExprPtr> init;
+            if (u8())
+                init = required();
+            auto ds = std::make_unique<DeclStmt>(std::move(type), std::move(name), std::move(init), l);
+            ds->initBlock = block();
+            return ds;
+        }
+        case Tag::IF:
+        {
+            auto is = std::make_unique<IfStmt>(required(), l);
+            is->thenBody = block();
+            size_t elifs = count();
+            for (size_t k = 0; k < elifs; ++k)
+            {
+                ExprPtr cond = required();
+                is->elifs.emplace_back(std::move(cond), block());
+            }
+            is->elseBody = block();
+            return is;
+        }
+        case Tag::FOR:
+        {
+            auto fs = std::make_unique<ForStmt>(str(), l);
+            fs->args = exprs();
+            fs->dims.resize(count());
+            for (auto &dim : fs->dims)
+            {
+                dim.iter = str();
+                dim.args = exprs();
+            }
+            fs->body = block();
+            markUncheckedIndexes(fs.get());
+            return fs;
+        }
+        case Tag::OBJ:
+        {
+            std::string className = str();
+            auto os = std::make_unique<ObjStmt>(std::move(className), expr(), l);
+            os->proto = str();
+            os->body = block();
+            return os;
+        }
+        case Tag::PROTO:
+        {
+            auto ps = std::make_unique<ProtoStmt>(str(), l);
+            ps->parent = str();
+            ps->body = block();
+            return ps;
+        }
+        case Tag::FN:
+        {
+            std::string name = str();
+            std::vector<std::string> params(count());
+            for (auto &p : params)
+                p = str();
+            auto fn = std::make_unique<FnStmt>(std::move(name), std::move(params), l);
+            fn->body = block();
+            return fn;
+        }
+        case Tag::BREAK:
+            return std::make_unique<BreakStmt>(block(), l);
+        case Tag::CONTINUE:
+            return std::make_unique<ContinueStmt>(block(), l);
+        default:
+            corrupt();
+        }
+    }
+
+    // 源代码哈希混入引擎版本, 作为缓存键
+    std::uint64_t cacheKey(std::string_view source)
+    {
+        return fnv1a64(source, fnv1a64(engineVersion()));
+    }
+}
+
+const std::string &engineVersion()
+{
+    static const std::string version = std::string(LUDUSCRIPT_VERSION) + "/ast" + std::to_string(AST_FORMAT_VERSION);
+    return version;
+}
+
+std::uint64_t fnv1a64(std::string_view data, std::uint64_t seed)
+{
+    std::uint64_t h = seed;
+    for (char c : data)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// 文件格式: "LDSC" | 引擎版本 | 源代码长度 | 源代码哈希 | 正文哈希 | 正文(字符串表 | 语句块)
+std::string serializeProgram(const Program &program, std::string_view source)
+{
+    Writer body;
+    body.block(program.stmts);
+
+    Writer payload;
+    payload.varint(body.strings.size());
+    for (auto &str : body.strings)
+        payload.bytes(str);
+    payload.out += body.out;
+
+    Writer w;
+    w.out.append(MAGIC, sizeof(MAGIC));
+    w.bytes(engineVersion());
+    w.varint(source.size());
+    w.varint(fnv1a64(source));
+    w.varint(fnv1a64(payload.out));
+    w.out += payload.out;
+    return std::move(w.out);
+}
+
+std::unique_ptr<Program> deserializeProgram(std::string_view data, std::string_view source)
+{
+    Reader r(data);
+    if (r.raw(sizeof(MAGIC)) != std::string_view(MAGIC, sizeof(MAGIC)))
+        throw std::runtime_error("Not a script cache file");
+    if (r.bytes() != engineVersion())
+        throw std::runtime_error("Script cache was written by a different engine version");
+    if (r.varint() != source.size() || r.varint() != fnv1a64(source))
+        throw std::runtime_error("Script cache does not match the source");
+    // 结构完好但内容被改动的正文(如字符串或数字中的一个字节)解码不会出错, 先校验哈希
+    if (r.varint() != fnv1a64(r.rest()))
+        throw std::runtime_error("Script cache is corrupt");
+
+    r.readStrings();
+    auto program = std::make_unique<Program>();
+    program->stmts = r.block();
+    if (!r.atEnd())
+        Reader::corrupt();
+    return program;
+}
+
+ScriptCache::ScriptCache(std::string dir) : dir(std::move(dir)) {}
+
+std::string ScriptCache::pathFor(std::string_view source) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.ldc", static_cast<unsigned long long>(cacheKey(source)));
+    return (std::filesystem::path(dir) / name).string();
+}
+
+std::unique_ptr<Program> ScriptCache::load(std::string_view source) const
+{
+    std::string path = pathFor(source);
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+        return nullptr;
+    try
+    {
+        SourceFile file(path);
+        return deserializeProgram(file.view(), source);
+    }
+    catch (const std::exception &)
+    {
+        // 过期或损坏的缓存由调用方重新生成
+        return nullptr;
+    }
+}
+
+bool ScriptCache::store(std::string_view source, const Program &program) const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    return writeFileAtomic(pathFor(source), serializeProgram(program, source));
+}
+
+bool writeFileAtomic(const std::string &path, std::string_view data)
+{
+    std::string tmp = path + ".tmp" + std::to_string(std::random_device{}());
+    {
+        std::ofstream ofs(tmp, std::ios::binary);
+        if (!ofs)
+            return false;
+        ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!ofs)
+            return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -1,8 +1,31 @@
 #include "interpreter.h"
+#include "alloc_stats.h"
+#include "node_stats.h"
 #include <stdexcept>
 #include <algorithm>
+#include <cmath>
 
 // Value implementation
+#ifdef LUDUSCRIPT_ALLOC_STATS
+Value::Value(const Value &o) : type(o.type), nval(o.nval), isInteger(o.isInteger), bval(o.bval), aval(o.aval)
+{
+    ALLOC_PHASE(VALUE_COPY);
+    sval = o.sval;
+}
+
+Value &Value::operator=(const Value &o)
+{
+    ALLOC_PHASE(VALUE_COPY);
+    type = o.type;
+    nval = o.nval;
+    isInteger = o.isInteger;
+    sval = o.sval;
+    bval = o.bval;
+    aval = o.aval;
+    return *this;
+}
+#endif
+
 Value Value::makeInt(ll i)
 {
     Value v;
@@ -37,6 +60,81 @@ Value Value::makeBool(bool b)
     return x;
 }
 
+Value Value::makeArr(std::shared_ptr<const Array> a)
+{
+    Value x;
+    x.type = Type::ARR;
+    x.aval = std::move(a);
+    return x;
+}
+
+Value Value::fromJson(const json &j)
+{
+    if (j.is_number())
+    {
+        double val = j.get<double>();
+        if (val == std::floor(val))
+            return makeInt(static_cast<ll>(val));
+        return makeNum(val);
+    }
+    if (j.is_string())
+        return makeStr(j.get<std::string>());
+    if (j.is_boolean())
+        return makeBool(j.get<bool>());
+    if (j.is_array())
+    {
+        auto arr = std::make_shared<Array>();
+        if (!j.empty() && j.front().is_string())
+        {
+            arr->elem = Array::Elem::STR;
+            for (auto &e : j)
+                arr->strs.push_back(e.get<std::string>());
+        }
+        else
+        {
+            for (auto &e : j)
+            {
+                arr->isInteger = arr->isInteger && e.is_number_integer();
+                arr->nums.push_back(e.get<double>());
+            }
+        }
+        return makeArr(std::move(arr));
+    }
+    throw std::runtime_error("Unsupported field value: " + j.dump());
+}
+
+json Value::toJson() const
+{
+    ALLOC_PHASE(JSON_BUILD);
+    if (type == Type::NUM && isInteger)
+        return json(static_cast<ll>(nval));
+    if (type == Type::NUM)
+        return json(nval);
+    if (type == Type::BOOL)
+        return json(bval);
+    if (type == Type::ARR)
+    {
+        json j = json::array();
+        if (aval->elem == Array::Elem::STR)
+        {
+            for (auto &s : aval->strs)
+                j.push_back(s);
+        }
+        else if (aval->isInteger)
+        {
+            for (double n : aval->nums)
+                j.push_back(static_cast<ll>(n));
+        }
+        else
+        {
+            for (double n : aval->nums)
+                j.push_back(n);
+        }
+        return j;
+    }
+    return json(sval);
+}
+
 std::string Value::toStr() const
 {
     if (type == Type::STR)
@@ -50,6 +148,17 @@ std::string Value::toStr() const
     }
     if (type == Type::BOOL)
         return bval ? "true" : "false";
+    if (type == Type::ARR)
+    {
+        std::string s = "[";
+        for (size_t i = 0; i < aval->size(); ++i)
+        {
+            if (i > 0)
+                s += ", ";
+            s += aval->at(i).toStr();
+        }
+        return s + "]";
+    }
     return "";
 }
 
@@ -101,6 +210,8 @@ bool Value::toBool() const
         return nval != 0.0;
     if (type == Type::STR)
         return !sval.empty();
+    if (type == Type::ARR)
+        return aval->size() > 0;
     return false;
 }
 
@@ -109,20 +220,47 @@ bool Value::isInt() const
     return type == Type::NUM && isInteger;
 }
 
+// Array implementation
+size_t Array::size() const
+{
+    return elem == Elem::STR ? strs.size() : nums.size();
+}
+
+Value Array::at(size_t i) const
+{
+    if (elem == Elem::STR)
+        return Value::makeStr(strs[i]);
+    if (isInteger)
+        return Value::makeInt(static_cast<ll>(nums[i]));
+    return Value::makeNum(nums[i]);
+}
+
+bool Array::operator==(const Array &o) const
+{
+    if (size() != o.size())
+        return false;
+    if (size() == 0)
+        return true;
+    return elem == o.elem && nums == o.nums && strs == o.strs;
+}
+
 // Env implementation
 void Env::pushScope()
 {
+    ALLOC_PHASE(SCOPE);
     stack.emplace_back();
 }
 
 void Env::popScope()
 {
+    ALLOC_PHASE(SCOPE);
     if (!stack.empty())
         stack.pop_back();
 }
 
 void Env::setVar(const std::string &k, const Value &v)
 {
+    ALLOC_PHASE(SCOPE);
     if (stack.empty())
         pushScope();
     stack.back()[k] = v;
@@ -139,24 +277,78 @@ std::optional<Value> Env::getVar(const std::string &k)
     return std::nullopt;
 }
 
+const Prototype &Env::getPrototype(const std::string &name) const
+{
+    auto it = prototypes.find(name);
+    if (it == prototypes.end())
+        throw std::runtime_error("Undefined prototype: " + name);
+    return it->second;
+}
+
 // Interpreter implementation
+void Interpreter::setProfiler(Profiler *p)
+{
+    profiler = p;
+}
+
+void Interpreter::setTracer(Tracer *t)
+{
+    tracer = t;
+}
+
+void Interpreter::setNodeStats(NodeStats *s)
+{
+    nodeStats = s;
+}
+
+void Interpreter::setScriptStack(ScriptStack *s)
+{
+    scriptStack = s;
+}
+
 void Interpreter::execute(Program *program)
 {
+    ALLOC_PHASE(EXECUTE);
     for (auto &stmt : program->stmts)
     {
-        execStmt(stmt.get());
+        execTopLevel(stmt.get());
+    }
+}
+
+void Interpreter::executeRange(Program *program, size_t begin, size_t end)
+{
+    ALLOC_PHASE(EXECUTE);
+    for (size_t i = begin; i < end && i < program->stmts.size(); ++i)
+    {
+        execTopLevel(program->stmts[i].get());
     }
 }
 
 std::string Interpreter::getOutput(bool pretty) const
 {
+    ALLOC_PHASE(SERIALIZE);
     if (pretty)
         return env.output.dump(2);
     else
         return env.output.dump();
 }
 
+size_t Interpreter::objectCount() const
+{
+    return env.output.size();
+}
+
 Value Interpreter::evalExpr(Expr *e)
+{
+    if (nodeStats)
+    {
+        NodeStats::Scope scope(*nodeStats, e);
+        return dispatchExpr(e);
+    }
+    return dispatchExpr(e);
+}
+
+Value Interpreter::dispatchExpr(Expr *e)
 {
     if (auto lit = dynamic_cast<LiteralExpr *>(e))
         return evalLiteral(lit);
@@ -168,6 +360,10 @@ Value Interpreter::evalExpr(Expr *e)
         return evalBinary(b);
     if (auto c = dynamic_cast<CallExpr *>(e))
         return evalCall(c);
+    if (auto ix = dynamic_cast<IndexExpr *>(e))
+        return evalIndex(ix);
+    if (auto arr = dynamic_cast<ArrayExpr *>(e))
+        return evalArray(arr);
     if (auto a = dynamic_cast<AccessExpr *>(e))
         return evalAccess(a);
     throw std::runtime_error("Unknown expression node");
@@ -202,18 +398,8 @@ Value Interpreter::evalIdent(IdentExpr *id)
         if (obj.contains(id->name))
         {
             auto& field = obj[id->name];
-            if (field.is_number())
-            {
-                double val = field.get<double>();
-                if (val == std::floor(val))
-                    return Value::makeInt(static_cast<ll>(val));
-                else
-                    return Value::makeNum(val);
-            }
-            else if (field.is_string())
-                return Value::makeStr(field.get<std::string>());
-            else if (field.is_boolean())
-                return Value::makeBool(field.get<bool>());
+            if (field.is_number() || field.is_string() || field.is_boolean() || field.is_array())
+                return Value::fromJson(field);
         }
     }
     
@@ -300,6 +486,8 @@ Value Interpreter::evalBinary(BinaryExpr *b)
                 return Value::makeBool(L.sval == R.sval);
             if (L.type == Value::Type::BOOL)
                 return Value::makeBool(L.bval == R.bval);
+            if (L.type == Value::Type::ARR)
+                return Value::makeBool(*L.aval == *R.aval);
         }
         return Value::makeBool(false);
     }
@@ -313,6 +501,8 @@ Value Interpreter::evalBinary(BinaryExpr *b)
                 return Value::makeBool(L.sval != R.sval);
             if (L.type == Value::Type::BOOL)
                 return Value::makeBool(L.bval != R.bval);
+            if (L.type == Value::Type::ARR)
+                return Value::makeBool(!(*L.aval == *R.aval));
         }
         return Value::makeBool(true);
     }
@@ -334,8 +524,92 @@ Value Interpreter::evalBinary(BinaryExpr *b)
 
 Value Interpreter::evalCall(CallExpr *c)
 {
-    // For now, we don't support function calls in this simple interpreter
-    throw std::runtime_error("Function calls not supported");
+    auto id = dynamic_cast<IdentExpr *>(c->callee.get());
+    if (!id)
+        throw std::runtime_error("Only named functions can be called");
+    
+    if (isBuiltinFunction(id->name))
+    {
+        std::vector<Value> args;
+        args.reserve(c->args.size());
+        for (auto &arg : c->args)
+            args.push_back(evalExpr(arg.get()));
+        return callBuiltin(id->name, args);
+    }
+    
+    auto it = functions.find(id->name);
+    if (it == functions.end())
+        throw std::runtime_error("Undefined function: " + id->name);
+    
+    Function &fn = it->second;
+    if (c->args.size() != fn.decl->params.size())
+        throw std::runtime_error("Function '" + id->name + "' expects " + std::to_string(fn.decl->params.size()) +
+                                 " arguments but got " + std::to_string(c->args.size()));
+    
+    std::vector<Value> args;
+    args.reserve(c->args.size());
+    for (auto &arg : c->args)
+        args.push_back(evalExpr(arg.get()));
+    
+    return callFunction(fn, args);
+}
+
+Value Interpreter::callBuiltin(const std::string &name, const std::vector<Value> &args)
+{
+    if (name == "len")
+    {
+        if (args.size() != 1)
+            throw std::runtime_error("Function 'len' expects 1 argument but got " + std::to_string(args.size()));
+        if (args[0].type == Value::Type::ARR)
+            return Value::makeInt(static_cast<ll>(args[0].aval->size()));
+        if (args[0].type == Value::Type::STR)
+            return Value::makeInt(static_cast<ll>(args[0].sval.size()));
+        throw std::runtime_error("Function 'len' expects an array or a string");
+    }
+    throw std::runtime_error("Undefined function: " + name);
+}
+
+Value Interpreter::evalArray(ArrayExpr *a)
+{
+    auto arr = std::make_shared<Array>();
+    for (size_t i = 0; i < a->elems.size(); ++i)
+    {
+        Value v = evalExpr(a->elems[i].get());
+        if (v.type != Value::Type::NUM && v.type != Value::Type::STR)
+            throw std::runtime_error("Array elements must be numbers or strings");
+        
+        // 元素类型由第一个元素决定
+        auto elem = v.type == Value::Type::STR ? Array::Elem::STR : Array::Elem::NUM;
+        if (i == 0)
+            arr->elem = elem;
+        else if (elem != arr->elem)
+            throw std::runtime_error("Array elements must all have the same type");
+        
+        if (elem == Array::Elem::STR)
+        {
+            arr->strs.push_back(std::move(v.sval));
+        }
+        else
+        {
+            arr->isInteger = arr->isInteger && v.isInteger;
+            arr->nums.push_back(v.nval);
+        }
+    }
+    return Value::makeArr(std::move(arr));
+}
+
+Value Interpreter::evalIndex(IndexExpr *ix)
+{
+    Value target = evalExpr(ix->target.get());
+    if (target.type != Value::Type::ARR)
+        throw std::runtime_error("Cannot index a non-array value");
+    ll i = evalExpr(ix->index.get()).toInt();
+    
+    // 循环范围已证明下标合法时跳过越界检查
+    if (ix->checked && (i < 0 || static_cast<size_t>(i) >= target.aval->size()))
+        throw std::runtime_error("Array index " + std::to_string(i) + " out of range (size " +
+                                 std::to_string(target.aval->size()) + ")");
+    return target.aval->at(static_cast<size_t>(i));
 }
 
 Value Interpreter::evalAccess(AccessExpr *a)
@@ -0,0 +1,322 @@
+#include "interpreter.h"
+#include "sampler.h"
+#include <cstdint>
+#include <stdexcept>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    // 最大调用深度, 防止无限递归耗尽栈空间
+    constexpr int MAX_CALL_DEPTH = 256;
+    // 函数调用链占用的栈空间上限. 未优化的构建中每层语句嵌套约占数 KB 栈,
+    // 函数体嵌套较深时, 不到 MAX_CALL_DEPTH 层的递归就会耗尽栈空间.
+    // 按 Linux 主线程和 std::thread 默认的 8 MiB 栈设置, 为调用链之外的嵌套(见 Parser::MAX_NESTING_DEPTH)留出余量
+    constexpr std::uintptr_t MAX_CALL_STACK_BYTES = 4 << 20;
+
+    // 当前栈帧的地址; 使用帧地址而不是局部变量的地址, 不受 AddressSanitizer 假栈的影响
+    std::uintptr_t stackAddress()
+    {
+#ifdef _MSC_VER
+        return reinterpret_cast<std::uintptr_t>(_AddressOfReturnAddress());
+#else
+        return reinterpret_cast<std::uintptr_t>(__builtin_frame_address(0));
+#endif
+    }
+
+    // Purity analysis 纯函数分析
+    // 函数体只读写形参和自身声明的局部变量, 不创建对象, 不定义函数, 只调用纯函数
+    class PurityChecker
+    {
+    public:
+        PurityChecker(const std::string &self, const std::unordered_map<std::string, Function> &fns)
+            : self(self), fns(fns) {}
+
+        bool check(FnStmt *fn)
+        {
+            scopes.emplace_back(fn->params.begin(), fn->params.end());
+            return block(fn->body);
+        }
+
+    private:
+        const std::string &self;
+        const std::unordered_map<std::string, Function> &fns;
+        std::vector<std::unordered_set<std::string>> scopes;
+        int loopDepth = 0;
+
+        bool declared(const std::string &name) const
+        {
+            for (auto &scope : scopes)
+                if (scope.count(name))
+                    return true;
+            return false;
+        }
+
+        // 与解释器一致: 语句块拥有独立作用域
+        bool block(const std::vector<StmtPtr> &body)
+        {
+            scopes.emplace_back();
+            bool ok = stmts(body);
+            scopes.pop_back();
+            return ok;
+        }
+
+        bool stmts(const std::vector<StmtPtr> &body)
+        {
+            for (auto &st : body)
+                if (!stmt(st.get()))
+                    return false;
+            return true;
+        }
+
+        bool stmt(Stmt *s)
+        {
+            if (auto es = dynamic_cast<ExprStmt *>(s))
+                return expr(es->expr.get());
+            if (auto as = dynamic_cast<AssignStmt *>(s))
+                return expr(as->expr.get()) && declared(as->name);
+            if (auto ds = dynamic_cast<DeclStmt *>(s))
+            {
+                if (ds->init.has_value() && !expr(ds->init->get()))
+                    return false;
+                if (!block(ds->initBlock))
+                    return false;
+                scopes.back().insert(ds->name);
+                return true;
+            }
+            if (auto is = dynamic_cast<IfStmt *>(s))
+            {
+                if (!expr(is->cond.get()) || !block(is->thenBody))
+                    return false;
+                for (auto &elif : is->elifs)
+                    if (!expr(elif.first.get()) || !block(elif.second))
+                        return false;
+                return block(is->elseBody);
+            }
+            if (auto fs = dynamic_cast<ForStmt *>(s))
+            {
+                for (auto &a : fs->args)
+                    if (!expr(a.get()))
+                        return false;
+                std::unordered_set<std::string> iters = {fs->iter};
+                for (auto &dim : fs->dims)
+                {
+                    for (auto &a : dim.args)
+                        if (!expr(a.get()))
+                            return false;
+                    iters.insert(dim.iter);
+                }
+                // 循环体与迭代变量共享同一作用域
+                scopes.push_back(std::move(iters));
+                ++loopDepth;
+                bool ok = stmts(fs->body);
+                --loopDepth;
+                scopes.pop_back();
+                return ok;
+            }
+            if (auto bs = dynamic_cast<BreakStmt *>(s))
+                return loopDepth > 0 && stmts(bs->body);
+            if (auto cs = dynamic_cast<ContinueStmt *>(s))
+                return loopDepth > 0 && stmts(cs->body);
+            // ObjStmt 会产生输出, FnStmt 会修改函数表
+            return false;
+        }
+
+        bool expr(Expr *e)
+        {
+            if (dynamic_cast<LiteralExpr *>(e))
+                return true;
+            if (auto id = dynamic_cast<IdentExpr *>(e))
+                return declared(id->name);
+            if (auto u = dynamic_cast<UnaryExpr *>(e))
+                return expr(u->rhs.get());
+            if (auto b = dynamic_cast<BinaryExpr *>(e))
+                return expr(b->lhs.get()) && expr(b->rhs.get());
+            if (auto arr = dynamic_cast<ArrayExpr *>(e))
+            {
+                for (auto &el : arr->elems)
+                    if (!expr(el.get()))
+                        return false;
+                return true;
+            }
+            if (auto ix = dynamic_cast<IndexExpr *>(e))
+                return expr(ix->target.get()) && expr(ix->index.get());
+            if (auto c = dynamic_cast<CallExpr *>(e))
+            {
+                auto id = dynamic_cast<IdentExpr *>(c->callee.get());
+                if (!id)
+                    return false;
+                if (id->name != self && !isBuiltinFunction(id->name))
+                {
+                    auto it = fns.find(id->name);
+                    if (it == fns.end() || !it->second.pure)
+                        return false;
+                }
+                for (auto &a : c->args)
+                    if (!expr(a.get()))
+                        return false;
+                return true;
+            }
+            return false;
+        }
+    };
+
+    template <typename T>
+    void appendBytes(std::string &key, const T &v)
+    {
+        key.append(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+
+    // 将实参元组编码为缓存键, 类型标记保证 1 / 1.0 / "1" 互不冲突
+    std::string memoKey(const std::vector<Value> &args)
+    {
+        std::string key;
+        for (auto &v : args)
+        {
+            if (v.type == Value::Type::NUM && v.isInteger)
+            {
+                key.push_back('i');
+                appendBytes(key, static_cast<ll>(v.nval));
+            }
+            else if (v.type == Value::Type::NUM)
+            {
+                key.push_back('n');
+                appendBytes(key, v.nval);
+            }
+            else if (v.type == Value::Type::BOOL)
+            {
+                key.push_back(v.bval ? 'T' : 'F');
+            }
+            else if (v.type == Value::Type::ARR)
+            {
+                key.push_back(v.aval->elem == Array::Elem::STR ? 'S' : (v.aval->isInteger ? 'A' : 'D'));
+                appendBytes(key, v.aval->size());
+                for (auto &s : v.aval->strs)
+                {
+                    appendBytes(key, s.size());
+                    key += s;
+                }
+                for (double n : v.aval->nums)
+                    appendBytes(key, n);
+            }
+            else
+            {
+                key.push_back('s');
+                appendBytes(key, v.sval.size());
+                key += v.sval;
+            }
+        }
+        return key;
+    }
+}
+
+void Interpreter::defineFunction(FnStmt *fn)
+{
+    if (isBuiltinFunction(fn->name))
+        throw std::runtime_error("Cannot redefine builtin function '" + fn->name + "'");
+
+    bool redefined = functions.count(fn->name) > 0;
+    Function &f = functions[fn->name];
+    f.decl = fn;
+    f.memo.clear();
+    f.pure = isPure(fn);
+
+    if (redefined)
+    {
+        // 重定义可能改变其他函数的纯度: 全部重置后迭代到不动点
+        for (auto &entry : functions)
+        {
+            entry.second.pure = false;
+            entry.second.memo.clear();
+        }
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto &entry : functions)
+            {
+                if (!entry.second.pure && isPure(entry.second.decl))
+                {
+                    entry.second.pure = true;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool Interpreter::isPure(FnStmt *fn) const
+{
+    return PurityChecker(fn->name, functions).check(fn);
+}
+
+Value Interpreter::callFunction(Function &fn, const std::vector<Value> &args)
+{
+    std::string key;
+    if (fn.pure)
+    {
+        key = memoKey(args);
+        auto it = fn.memo.find(key);
+        if (it != fn.memo.end())
+            return it->second;
+    }
+
+    const std::string &name = fn.decl->name;
+    // 栈向低地址增长
+    std::uintptr_t stack = stackAddress();
+    if (callDepth == 0)
+        callStackBase = stack;
+    if (callDepth >= MAX_CALL_DEPTH || (callStackBase > stack && callStackBase - stack > MAX_CALL_STACK_BYTES))
+        throw std::runtime_error("Maximum call depth exceeded in function '" + name + "'");
+
+    // 函数体不能读写调用方正在构建的对象, 调用期间挂起对象上下文
+    std::optional<json> savedObject;
+    savedObject.swap(env.current_object);
+    std::unordered_set<std::string> savedFields;
+    savedFields.swap(env.declared_fields);
+    size_t savedDepth = env.stack.size();
+
+    auto restore = [&]()
+    {
+        env.stack.resize(savedDepth);
+        env.current_object.swap(savedObject);
+        env.declared_fields.swap(savedFields);
+        --callDepth;
+    };
+
+    std::optional<ScriptStack::Frame> frame;
+    if (scriptStack)
+        frame.emplace(*scriptStack, fn.decl);
+
+    ++callDepth;
+    env.pushScope();
+    for (size_t i = 0; i < args.size(); ++i)
+        env.stack.back()[fn.decl->params[i]] = args[i];
+
+    Value result;
+    try
+    {
+        result = execBlockWithReturn(fn.decl->body);
+    }
+    catch (const BreakException &)
+    {
+        restore();
+        throw std::runtime_error("'break' outside of loop in function '" + name + "'");
+    }
+    catch (const ContinueException &)
+    {
+        restore();
+        throw std::runtime_error("'continue' outside of loop in function '" + name + "'");
+    }
+    catch (...)
+    {
+        restore();
+        throw;
+    }
+    restore();
+
+    if (fn.pure)
+        fn.memo.emplace(std::move(key), result);
+    return result;
+}
@@ -0,0 +1,194 @@
+#include "interpreter.h"
+#include "alloc_stats.h"
+#include <stdexcept>
+#include <climits>
+#include <cmath>
+
+namespace
+{
+    [[noreturn]] void notEligible(const std::string &reason, int line)
+    {
+        throw std::runtime_error("Script is not eligible for --index (line " + std::to_string(line) + "): " + reason);
+    }
+
+    bool containsObj(Node *n)
+    {
+        if (dynamic_cast<ObjStmt *>(n))
+            return true;
+        bool found = false;
+        forEachChild(n, [&](Node *child)
+                     { found = found || containsObj(child); });
+        return found;
+    }
+
+    // Counter update 计数器更新: x = x + c 或 x = x - c, c 为数字字面量
+    struct CounterStep
+    {
+        std::string name;
+        Value delta;
+    };
+
+    bool parseCounterStep(AssignStmt *as, CounterStep &step)
+    {
+        auto b = dynamic_cast<BinaryExpr *>(as->expr.get());
+        if (!b || (b->op != "+" && b->op != "-"))
+            return false;
+        auto id = dynamic_cast<IdentExpr *>(b->lhs.get());
+        auto lit = dynamic_cast<LiteralExpr *>(b->rhs.get());
+        if (!id || id->name != as->name || !lit)
+            return false;
+
+        ll sign = b->op == "+" ? 1 : -1;
+        if (lit->kind == LiteralExpr::Kind::INTEGER)
+            step.delta = Value::makeInt(sign * lit->ival);
+        else if (lit->kind == LiteralExpr::Kind::FLOAT)
+            step.delta = Value::makeNum(sign * lit->dval);
+        else
+            return false;
+        step.name = as->name;
+        return true;
+    }
+
+    // 等价于执行 times 次 v = v + delta, 结果与顺序执行逐次相加完全相同.
+    // 整数在 2^52 以内时每一步都精确, 直接相乘; 浮点数逐次相加的舍入与一次乘法不同, 只能重复相加
+    Value advance(const Value &v, const Value &delta, ll times)
+    {
+        constexpr double EXACT_LIMIT = 4503599627370496.0; // 2^52
+        if (v.isInteger && delta.isInteger &&
+            std::fabs(v.nval) + std::fabs(delta.nval) * static_cast<double>(times) <= EXACT_LIMIT)
+            return Value::makeInt(static_cast<ll>(v.nval) + static_cast<ll>(delta.nval) * times);
+
+        Value r = v;
+        for (ll i = 0; i < times; ++i)
+        {
+            if (r.isInteger && delta.isInteger)
+                r = Value::makeInt(static_cast<ll>(r.nval) + static_cast<ll>(delta.nval));
+            else
+                r = Value::makeNum(r.nval + delta.nval);
+        }
+        return r;
+    }
+}
+
+// 按顺序执行顶层语句, 但跳过目标之前的对象: 顶层对象直接计数,
+// 顶层循环根据迭代空间直接计算目标对象所在的迭代坐标和计数器的值
+void Interpreter::executeIndex(Program *program, ll index, size_t first)
+{
+    ALLOC_PHASE(EXECUTE);
+    if (index < 0)
+        throw std::runtime_error("Object index must not be negative");
+
+    auto advanceCounters = [&](const std::vector<CounterStep> &steps, size_t n, ll times)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            // Update the variable in the scope where it is defined
+            for (int d = int(env.stack.size()) - 1; d >= 0; --d)
+            {
+                auto it = env.stack[d].find(steps[i].name);
+                if (it != env.stack[d].end())
+                {
+                    it->second = advance(it->second, steps[i].delta, times);
+                    break;
+                }
+            }
+        }
+    };
+
+    ll emitted = 0;
+    for (size_t i = first; i < program->stmts.size(); ++i)
+    {
+        Stmt *s = program->stmts[i].get();
+        if (!containsObj(s))
+        {
+            execTopLevel(s);
+            continue;
+        }
+
+        if (auto os = dynamic_cast<ObjStmt *>(s))
+        {
+            // 跳过的对象不能影响之后的语句
+            if (!onlyBuildsObjects(os, {}))
+                notEligible("object body modifies variables outside the object", os->line);
+            if (emitted == index)
+            {
+                execTopLevel(os);
+                return;
+            }
+            ++emitted;
+            continue;
+        }
+
+        auto fs = dynamic_cast<ForStmt *>(s);
+        if (!fs)
+            notEligible("objects may only be created by top-level obj and for statements", s->line);
+
+        // Loop body: obj statements and counter updates only
+        auto iters = iterNames(fs);
+        std::vector<ObjStmt *> objs;
+        std::vector<size_t> stepsBefore; // 每个对象之前的计数器更新数
+        std::vector<CounterStep> steps;
+        for (auto &st : fs->body)
+        {
+            if (auto os = dynamic_cast<ObjStmt *>(st.get()))
+            {
+                if (!onlyBuildsObjects(os, iters))
+                    notEligible("object body modifies variables outside the object", os->line);
+                stepsBefore.push_back(steps.size());
+                objs.push_back(os);
+            }
+            else if (auto as = dynamic_cast<AssignStmt *>(st.get()))
+            {
+                CounterStep step;
+                if (!parseCounterStep(as, step) || iters.count(as->name))
+                    notEligible("assignments in the loop must be counter updates like 'x = x + 1'", as->line);
+                auto v = env.getVar(as->name);
+                if (!v.has_value() || v->type != Value::Type::NUM)
+                    notEligible("counter '" + as->name + "' must be a numeric variable", as->line);
+                steps.push_back(step);
+            }
+            else
+            {
+                notEligible("loop body may only contain obj statements and counter updates", st->line);
+            }
+        }
+
+        IterSpace space = evalIterSpace(fs);
+        ll perIter = static_cast<ll>(objs.size());
+        if (space.total > LLONG_MAX / perIter)
+            throw std::runtime_error("Loop iteration space is too large");
+        ll count = space.total * perIter;
+
+        if (index - emitted < count)
+        {
+            ll offset = index - emitted;
+            ll k = offset / perIter;
+            size_t p = static_cast<size_t>(offset % perIter);
+
+            // k 次完整迭代加上本次迭代中目标对象之前的更新
+            advanceCounters(steps, steps.size(), k);
+            advanceCounters(steps, stepsBefore[p], 1);
+
+            env.pushScope();
+            std::vector<ll> coords;
+            setIterVars(fs, space, k, coords);
+            try
+            {
+                execStmt(objs[p]);
+            }
+            catch (...)
+            {
+                env.popScope();
+                throw;
+            }
+            env.popScope();
+            return;
+        }
+
+        emitted += count;
+        advanceCounters(steps, steps.size(), space.total);
+    }
+
+    throw std::runtime_error("Object index " + std::to_string(index) + " is out of range (script produces " +
+                             std::to_string(emitted) + " objects)");
+}
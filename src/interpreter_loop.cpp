@@ -0,0 +1,331 @@
+#include "interpreter.h"
+#include "tracer.h"
+#include <stdexcept>
+#include <climits>
+#include <thread>
+#include <exception>
+
+namespace
+{
+    // 每个线程至少分到的迭代次数, 迭代太少时并行得不偿失
+    constexpr ll PARALLEL_MIN_CHUNK = 64;
+
+    // Independence analysis 独立性分析
+    // 语句只产生对象, 不读写循环作用域和外层变量时, 执行与否和执行顺序都不影响其他语句
+    class IndependenceChecker
+    {
+    public:
+        IndependenceChecker(const Env &env, const std::unordered_map<std::string, Function> &fns,
+                            const std::unordered_set<std::string> &iters)
+            : env(env), fns(fns), iters(iters) {}
+
+        bool check(Stmt *s)
+        {
+            return stmt(s, false, 0);
+        }
+
+    private:
+        const Env &env;
+        const std::unordered_map<std::string, Function> &fns;
+        const std::unordered_set<std::string> &iters;
+
+        // 循环开始时已存在的变量, 写入它们会影响之后的迭代
+        bool outerVar(const std::string &name) const
+        {
+            if (iters.count(name))
+                return true;
+            for (auto &scope : env.stack)
+                if (scope.count(name))
+                    return true;
+            return false;
+        }
+
+        bool stmts(const std::vector<StmtPtr> &body, bool inObj, int loopDepth)
+        {
+            for (auto &st : body)
+                if (!stmt(st.get(), inObj, loopDepth))
+                    return false;
+            return true;
+        }
+
+        bool stmt(Stmt *s, bool inObj, int loopDepth)
+        {
+            if (auto es = dynamic_cast<ExprStmt *>(s))
+                return expr(es->expr.get());
+            // 对象外的声明和赋值会写入循环作用域或外层变量
+            if (auto as = dynamic_cast<AssignStmt *>(s))
+                return inObj && !outerVar(as->name) && expr(as->expr.get());
+            if (auto ds = dynamic_cast<DeclStmt *>(s))
+            {
+                if (!inObj)
+                    return false;
+                if (ds->init.has_value() && !expr(ds->init->get()))
+                    return false;
+                return stmts(ds->initBlock, inObj, loopDepth);
+            }
+            if (auto is = dynamic_cast<IfStmt *>(s))
+            {
+                if (!expr(is->cond.get()) || !stmts(is->thenBody, inObj, loopDepth))
+                    return false;
+                for (auto &elif : is->elifs)
+                    if (!expr(elif.first.get()) || !stmts(elif.second, inObj, loopDepth))
+                        return false;
+                return stmts(is->elseBody, inObj, loopDepth);
+            }
+            if (auto fs = dynamic_cast<ForStmt *>(s))
+            {
+                for (auto &a : fs->args)
+                    if (!expr(a.get()))
+                        return false;
+                for (auto &dim : fs->dims)
+                    for (auto &a : dim.args)
+                        if (!expr(a.get()))
+                            return false;
+                return stmts(fs->body, inObj, loopDepth + 1);
+            }
+            if (auto os = dynamic_cast<ObjStmt *>(s))
+                return !inObj && expr(os->idExpr.get()) && stmts(os->body, true, loopDepth);
+            // break 只允许跳出内层循环, 跳出并行循环本身依赖迭代顺序
+            if (auto bs = dynamic_cast<BreakStmt *>(s))
+                return loopDepth > 0 && stmts(bs->body, inObj, loopDepth);
+            if (auto cs = dynamic_cast<ContinueStmt *>(s))
+                return stmts(cs->body, inObj, loopDepth);
+            return false;
+        }
+
+        bool expr(Expr *e)
+        {
+            if (dynamic_cast<AccessExpr *>(e))
+                return false;
+            if (auto c = dynamic_cast<CallExpr *>(e))
+            {
+                auto id = dynamic_cast<IdentExpr *>(c->callee.get());
+                if (!id)
+                    return false;
+                if (!isBuiltinFunction(id->name))
+                {
+                    auto it = fns.find(id->name);
+                    if (it == fns.end() || !it->second.pure)
+                        return false;
+                }
+            }
+            bool ok = true;
+            forEachChild(e, [&](Node *child)
+                         { ok = ok && expr(static_cast<Expr *>(child)); });
+            return ok;
+        }
+    };
+}
+
+// IterSpace implementation
+ll IterSpace::value(size_t dim, ll coord) const
+{
+    return ranges[dim].start + coord * ranges[dim].step;
+}
+
+void IterSpace::coords(ll k, std::vector<ll> &out) const
+{
+    out.resize(ranges.size());
+    for (size_t d = ranges.size(); d-- > 0;)
+    {
+        ll count = ranges[d].count;
+        out[d] = value(d, k % count);
+        k /= count;
+    }
+}
+
+void Interpreter::setThreads(unsigned n)
+{
+    threads = n;
+}
+
+LoopRange Interpreter::evalRange(const std::vector<ExprPtr> &args)
+{
+    ll start = 1, end = 1, step = 1;
+
+    if (args.size() == 1)
+    {
+        // for(i, N) -> i from 1 to N
+        end = evalExpr(args[0].get()).toInt();
+    }
+    else if (args.size() == 2)
+    {
+        // for(i, start, end) -> i from start to end
+        start = evalExpr(args[0].get()).toInt();
+        end = evalExpr(args[1].get()).toInt();
+    }
+    else if (args.size() == 3)
+    {
+        // for(i, start, end, step)
+        start = evalExpr(args[0].get()).toInt();
+        end = evalExpr(args[1].get()).toInt();
+        step = evalExpr(args[2].get()).toInt();
+    }
+
+    if (step == 0)
+        step = 1;
+
+    LoopRange r;
+    r.start = start;
+    r.step = step;
+    if (step > 0)
+        r.count = end >= start ? (end - start) / step + 1 : 0;
+    else
+        r.count = start >= end ? (start - end) / -step + 1 : 0;
+    return r;
+}
+
+IterSpace Interpreter::evalIterSpace(ForStmt *fs)
+{
+    IterSpace space;
+    space.ranges.push_back(evalRange(fs->args));
+    for (auto &dim : fs->dims)
+        space.ranges.push_back(evalRange(dim.args));
+
+    for (auto &r : space.ranges)
+    {
+        if (r.count != 0 && space.total > LLONG_MAX / r.count)
+            throw std::runtime_error("Loop iteration space is too large");
+        space.total *= r.count;
+    }
+    return space;
+}
+
+void Interpreter::setIterVars(ForStmt *fs, const IterSpace &space, ll k, std::vector<ll> &coords)
+{
+    space.coords(k, coords);
+    env.setVar(fs->iter, Value::makeInt(coords[0]));
+    for (size_t d = 0; d < fs->dims.size(); ++d)
+        env.setVar(fs->dims[d].iter, Value::makeInt(coords[d + 1]));
+}
+
+bool Interpreter::isParallelizable(ForStmt *fs) const
+{
+    // 每次迭代只产生对象, 不读写上一次迭代留下的状态时, 迭代空间可以拆分到多个线程
+    auto iters = iterNames(fs);
+    for (auto &st : fs->body)
+        if (!onlyBuildsObjects(st.get(), iters))
+            return false;
+    return true;
+}
+
+bool Interpreter::onlyBuildsObjects(Stmt *s, const std::unordered_set<std::string> &iters) const
+{
+    return IndependenceChecker(env, functions, iters).check(s);
+}
+
+std::unordered_set<std::string> Interpreter::iterNames(ForStmt *fs)
+{
+    std::unordered_set<std::string> iters = {fs->iter};
+    for (auto &dim : fs->dims)
+        iters.insert(dim.iter);
+    return iters;
+}
+
+void Interpreter::execFor(ForStmt *fs)
+{
+    // 单层循环和笛卡尔积循环都按扁平下标 0..total-1 迭代
+    IterSpace space = evalIterSpace(fs);
+
+    ll workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, space.total / PARALLEL_MIN_CHUNK);
+    // 剖析时顺序执行, 保证每条语句都被记录
+    if (workers >= 2 && !profiler && !nodeStats && !scriptStack && !env.current_object.has_value() &&
+        isParallelizable(fs))
+    {
+        execForParallel(fs, space, static_cast<unsigned>(workers));
+        return;
+    }
+
+    env.pushScope();
+    std::vector<ll> coords;
+    for (ll k = 0; k < space.total; ++k)
+    {
+        setIterVars(fs, space, k, coords);
+        try
+        {
+            // Execute statements directly without creating additional scope
+            for (auto &st : fs->body)
+                execStmt(st.get());
+        }
+        catch (const BreakException&)
+        {
+            break;
+        }
+        catch (const ContinueException&)
+        {
+            continue;
+        }
+        catch (...)
+        {
+            env.popScope();
+            throw;
+        }
+    }
+    env.popScope();
+}
+
+// 将迭代空间按连续区间拆分到多个线程, 每个线程使用环境副本,
+// 结束后按区间顺序合并输出, 结果与顺序执行一致
+void Interpreter::execForParallel(ForStmt *fs, const IterSpace &space, unsigned workers)
+{
+    std::vector<std::unique_ptr<Interpreter>> interps;
+    std::vector<std::exception_ptr> errors(workers);
+    for (unsigned w = 0; w < workers; ++w)
+    {
+        auto worker = std::make_unique<Interpreter>();
+        worker->env.stack = env.stack;
+        worker->env.prototypes = env.prototypes;
+        worker->functions = functions;
+        worker->threads = 1;
+        worker->tracer = tracer;
+        worker->traceTid = w + 1;
+        worker->env.pushScope();
+        interps.push_back(std::move(worker));
+    }
+
+    ll chunk = (space.total + workers - 1) / workers;
+    std::vector<std::thread> pool;
+    for (unsigned w = 0; w < workers; ++w)
+    {
+        pool.emplace_back([&, w]()
+                          {
+            Interpreter &self = *interps[w];
+            ll begin = std::min(space.total, w * chunk);
+            ll end = std::min(space.total, begin + chunk);
+            std::vector<ll> coords;
+            std::optional<Tracer::Scope> chunkScope;
+            if (tracer)
+                chunkScope.emplace(*tracer, "chunk", nullptr, fs->line, self.traceTid);
+            try
+            {
+                for (ll k = begin; k < end; ++k)
+                {
+                    self.setIterVars(fs, space, k, coords);
+                    try
+                    {
+                        for (auto &st : fs->body)
+                            self.execStmt(st.get());
+                    }
+                    catch (const ContinueException&)
+                    {
+                    }
+                }
+            }
+            catch (...)
+            {
+                errors[w] = std::current_exception();
+            } });
+    }
+    for (auto &t : pool)
+        t.join();
+
+    // 报告扁平下标最小的错误
+    for (auto &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+
+    for (auto &worker : interps)
+        for (auto &obj : worker->env.output)
+            env.output.push_back(std::move(obj));
+}
@@ -0,0 +1,299 @@
+#include "interpreter.h"
+#include "ast_cache.h"
+#include <cctype>
+#include <stdexcept>
+
+namespace
+{
+    constexpr const char *SNAPSHOT_MAGIC = "LDSS";
+    constexpr int SNAPSHOT_FORMAT_VERSION = 2;
+
+    const char *typeName(Value::Type t)
+    {
+        switch (t)
+        {
+        case Value::Type::NUM:
+            return "num";
+        case Value::Type::STR:
+            return "str";
+        case Value::Type::BOOL:
+            return "bool";
+        default:
+            return "arr";
+        }
+    }
+
+    // Value encoding 值的编码, 保留整数标记和数组元素类型:
+    // [0, isInteger, n] | [1, s] | [2, b] | [3, isStr, isInteger, elems]
+    json encodeValue(const Value &v)
+    {
+        switch (v.type)
+        {
+        case Value::Type::NUM:
+            return json::array({0, v.isInteger, v.nval});
+        case Value::Type::STR:
+            return json::array({1, v.sval});
+        case Value::Type::BOOL:
+            return json::array({2, v.bval});
+        default:
+        {
+            bool isStr = v.aval->elem == Array::Elem::STR;
+            json elems = isStr ? json(v.aval->strs) : json(v.aval->nums);
+            return json::array({3, isStr, v.aval->isInteger, std::move(elems)});
+        }
+        }
+    }
+
+    Value decodeValue(const json &j)
+    {
+        switch (j.at(0).get<int>())
+        {
+        case 0:
+        {
+            Value v = Value::makeNum(j.at(2).get<double>());
+            v.isInteger = j.at(1).get<bool>();
+            return v;
+        }
+        case 1:
+            return Value::makeStr(j.at(1).get<std::string>());
+        case 2:
+            return Value::makeBool(j.at(1).get<bool>());
+        case 3:
+        {
+            auto arr = std::make_shared<Array>();
+            arr->isInteger = j.at(2).get<bool>();
+            if (j.at(1).get<bool>())
+            {
+                arr->elem = Array::Elem::STR;
+                arr->strs = j.at(3).get<std::vector<std::string>>();
+            }
+            else
+            {
+                arr->nums = j.at(3).get<std::vector<double>>();
+            }
+            return Value::makeArr(std::move(arr));
+        }
+        default:
+            throw std::runtime_error("Corrupt snapshot: unknown value type");
+        }
+    }
+
+    bool containsObj(Node *n)
+    {
+        if (dynamic_cast<ObjStmt *>(n))
+            return true;
+        bool found = false;
+        forEachChild(n, [&](Node *child)
+                     { found = found || containsObj(child); });
+        return found;
+    }
+
+    // 在前导段中按函数名和行号查找定义, 快照只记录这两者
+    FnStmt *findFunction(Node *n, const std::string &name, int line)
+    {
+        if (auto fn = dynamic_cast<FnStmt *>(n))
+            if (fn->name == name && fn->line == line)
+                return fn;
+        FnStmt *found = nullptr;
+        forEachChild(n, [&](Node *child)
+                     {
+            if (!found)
+                found = findFunction(child, name, line); });
+        return found;
+    }
+
+    bool isIdentifier(const std::string &s)
+    {
+        if (s.empty() || std::isdigit(static_cast<unsigned char>(s[0])))
+            return false;
+        for (char c : s)
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_')
+                return false;
+        return true;
+    }
+
+    // 与脚本中的字面量一致: 整数、小数、true/false, 其余按字符串处理
+    Value parseParamValue(const std::string &text)
+    {
+        if (text == "true" || text == "false")
+            return Value::makeBool(text == "true");
+        size_t digits = text[0] == '-' ? 1 : 0;
+        if (digits < text.size() && std::isdigit(static_cast<unsigned char>(text[digits])))
+        {
+            try
+            {
+                size_t used = 0;
+                if (text.find_first_of(".eE") == std::string::npos)
+                {
+                    ll i = std::stoll(text, &used);
+                    if (used == text.size())
+                        return Value::makeInt(i);
+                }
+                else
+                {
+                    double d = std::stod(text, &used);
+                    if (used == text.size())
+                        return Value::makeNum(d);
+                }
+            }
+            catch (const std::exception &)
+            {
+                // 超出范围的数字按字符串处理
+            }
+        }
+        return Value::makeStr(text);
+    }
+}
+
+size_t Interpreter::preludeLength(const Program *program)
+{
+    size_t n = 0;
+    while (n < program->stmts.size() && !containsObj(program->stmts[n].get()))
+        ++n;
+    return n;
+}
+
+// 快照内容: 文件头(格式、引擎版本、源代码长度和哈希、前导段长度、正文哈希) + 正文,
+// 正文(作用域栈 + 原型 + 函数 + 输出)单独以 MessagePack 编码, 编码后的字节作为 str 字段存入
+// (MessagePack 的 str 不校验 UTF-8, 快照不会以 JSON 文本输出), 载入时先校验哈希再解码.
+// 纯函数的记忆表不保存, 恢复后重新积累
+std::string Interpreter::saveSnapshot(const Program *program, std::string_view source) const
+{
+    json body;
+    json scopes = json::array();
+    for (auto &scope : env.stack)
+    {
+        json vars = json::object();
+        for (auto &entry : scope)
+            vars[entry.first] = encodeValue(entry.second);
+        scopes.push_back(std::move(vars));
+    }
+    body["scopes"] = std::move(scopes);
+
+    json prototypes = json::object();
+    for (auto &entry : env.prototypes)
+        prototypes[entry.first] = {{"fields", entry.second.fields}, {"names", entry.second.names}};
+    body["prototypes"] = std::move(prototypes);
+
+    json fns = json::array();
+    for (auto &entry : functions)
+        fns.push_back({entry.first, entry.second.decl->line, entry.second.pure});
+    body["functions"] = std::move(fns);
+
+    body["output"] = env.output;
+
+    std::vector<std::uint8_t> bytes = json::to_msgpack(body);
+    std::string encoded(bytes.begin(), bytes.end());
+    json snap;
+    snap["magic"] = SNAPSHOT_MAGIC;
+    snap["format"] = SNAPSHOT_FORMAT_VERSION;
+    snap["engine"] = engineVersion();
+    snap["source_size"] = source.size();
+    snap["source_hash"] = fnv1a64(source);
+    snap["prelude"] = preludeLength(program);
+    snap["body_hash"] = fnv1a64(encoded);
+    snap["body"] = std::move(encoded);
+
+    bytes = json::to_msgpack(snap);
+    return std::string(bytes.begin(), bytes.end());
+}
+
+void Interpreter::loadSnapshot(std::string_view data, Program *program, std::string_view source)
+{
+    std::vector<std::unordered_map<std::string, Value>> stack;
+    std::unordered_map<std::string, Prototype> prototypes;
+    std::unordered_map<std::string, Function> fns;
+    json output;
+    try
+    {
+        json snap = json::from_msgpack(data.begin(), data.end());
+        if (!snap.is_object() || snap.value("magic", "") != SNAPSHOT_MAGIC ||
+            snap.value("format", 0) != SNAPSHOT_FORMAT_VERSION)
+            throw std::runtime_error("Not a prelude snapshot");
+        if (snap.at("engine").get<std::string>() != engineVersion())
+            throw std::runtime_error("Snapshot was written by a different engine version");
+        size_t prelude = preludeLength(program);
+        if (snap.at("source_size").get<size_t>() != source.size() ||
+            snap.at("source_hash").get<std::uint64_t>() != fnv1a64(source) ||
+            snap.at("prelude").get<size_t>() != prelude)
+            throw std::runtime_error("Snapshot does not match the source");
+
+        // 结构完好但内容被改动的正文同样能解码, 只能由哈希发现
+        auto &encoded = snap.at("body").get_ref<const std::string &>();
+        if (snap.at("body_hash").get<std::uint64_t>() != fnv1a64(encoded))
+            throw std::runtime_error("Corrupt snapshot: body checksum mismatch");
+        json body = json::from_msgpack(encoded.begin(), encoded.end());
+
+        for (auto &vars : body.at("scopes"))
+        {
+            auto &scope = stack.emplace_back();
+            for (auto &entry : vars.items())
+                scope.emplace(entry.key(), decodeValue(entry.value()));
+        }
+
+        for (auto &entry : body.at("prototypes").items())
+        {
+            Prototype &proto = prototypes[entry.key()];
+            proto.fields = entry.value().at("fields");
+            proto.names = entry.value().at("names").get<std::unordered_set<std::string>>();
+        }
+
+        for (auto &entry : body.at("functions"))
+        {
+            auto name = entry.at(0).get<std::string>();
+            int line = entry.at(1).get<int>();
+            FnStmt *decl = nullptr;
+            for (size_t i = 0; i < prelude && !decl; ++i)
+                decl = findFunction(program->stmts[i].get(), name, line);
+            if (!decl)
+                throw std::runtime_error("Snapshot refers to an unknown function '" + name + "'");
+            Function &f = fns[name];
+            f.decl = decl;
+            f.pure = entry.at(2).get<bool>();
+        }
+
+        output = std::move(body.at("output"));
+        if (!output.is_array())
+            throw std::runtime_error("Corrupt snapshot: output is not an array");
+    }
+    catch (const json::exception &ex)
+    {
+        throw std::runtime_error(std::string("Corrupt snapshot: ") + ex.what());
+    }
+
+    env.stack = std::move(stack);
+    env.prototypes = std::move(prototypes);
+    env.output = std::move(output);
+    functions = std::move(fns);
+}
+
+void Interpreter::setParam(const std::string &name, const std::string &text)
+{
+    if (!isIdentifier(name))
+        throw std::runtime_error("Invalid parameter name '" + name + "'");
+    if (env.stack.empty())
+        env.pushScope();
+
+    auto &globals = env.stack.front();
+    Value v = parseParamValue(text);
+    auto it = globals.find(name);
+    if (it != globals.end() && it->second.type != v.type)
+    {
+        if (it->second.type != Value::Type::STR)
+            throw std::runtime_error("Parameter '" + name + "' must be a " + typeName(it->second.type) +
+                                     ", got '" + text + "'");
+        v = Value::makeStr(text);
+    }
+    globals[name] = std::move(v);
+}
+
+Interpreter::State Interpreter::captureState() const
+{
+    return {env, functions};
+}
+
+void Interpreter::restoreState(const State &state)
+{
+    env = state.env;
+    functions = state.functions;
+}
@@ -1,7 +1,74 @@
 #include "interpreter.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "alloc_stats.h"
+#include "node_stats.h"
+#include "sampler.h"
 #include <stdexcept>
 
+namespace
+{
+    // Statement kind names for the trace timeline 时间线中的语句名
+    const char *stmtKindName(Stmt *s)
+    {
+        if (dynamic_cast<ObjStmt *>(s))
+            return "obj";
+        if (dynamic_cast<ForStmt *>(s))
+            return "for";
+        if (dynamic_cast<IfStmt *>(s))
+            return "if";
+        if (dynamic_cast<DeclStmt *>(s))
+            return "decl";
+        if (dynamic_cast<AssignStmt *>(s))
+            return "assign";
+        if (dynamic_cast<FnStmt *>(s))
+            return "fn";
+        if (dynamic_cast<ProtoStmt *>(s))
+            return "proto";
+        return "stmt";
+    }
+}
+
 void Interpreter::execStmt(Stmt *s)
+{
+    if (!profiler && !tracer && !nodeStats && !scriptStack)
+    {
+        dispatchStmt(s);
+        return;
+    }
+    
+    std::optional<ScriptStack::Frame> frame;
+    if (scriptStack)
+        frame.emplace(*scriptStack, s);
+    
+    std::optional<NodeStats::Scope> nodeScope;
+    if (nodeStats)
+        nodeScope.emplace(*nodeStats, s);
+    
+    auto os = dynamic_cast<ObjStmt *>(s);
+    std::optional<Profiler::Scope> profScope;
+    if (profiler)
+        profScope.emplace(*profiler, s->line, os ? &os->className : nullptr);
+    std::optional<Tracer::Scope> traceScope;
+    if (tracer && os && tracer->sampleObj(objsSeen++))
+        traceScope.emplace(*tracer, "obj", &os->className, os->line, traceTid, true);
+    dispatchStmt(s);
+}
+
+// 顶层语句在时间线中各占一个事件
+void Interpreter::execTopLevel(Stmt *s)
+{
+    if (!tracer)
+    {
+        execStmt(s);
+        return;
+    }
+    
+    Tracer::Scope scope(*tracer, stmtKindName(s), nullptr, s->line, traceTid);
+    execStmt(s);
+}
+
+void Interpreter::dispatchStmt(Stmt *s)
 {
     if (auto es = dynamic_cast<ExprStmt *>(s))
     {
@@ -40,30 +107,17 @@ void Interpreter::execStmt(Stmt *s)
             // Variable doesn't exist in stack, check if inside object
             if (env.current_object.has_value())
             {
+                ALLOC_PHASE(JSON_BUILD);
                 // Check if it's already declared as object field
                 if (env.declared_fields.count(as->name) > 0 || env.current_object->contains(as->name))
                 {
                     // Update existing object field
-                    if (v.type == Value::Type::NUM && v.isInteger)
-                        env.current_object->operator[](as->name) = json(static_cast<ll>(v.nval));
-                    else if (v.type == Value::Type::NUM)
-                        env.current_object->operator[](as->name) = json(v.nval);
-                    else if (v.type == Value::Type::BOOL)
-                        env.current_object->operator[](as->name) = json(v.bval);
-                    else
-                        env.current_object->operator[](as->name) = json(v.sval);
+                    env.current_object->operator[](as->name) = v.toJson();
                 }
                 else
                 {
                     // Create new object field
-                    if (v.type == Value::Type::NUM && v.isInteger)
-                        env.current_object->operator[](as->name) = json(static_cast<ll>(v.nval));
-                    else if (v.type == Value::Type::NUM)
-                        env.current_object->operator[](as->name) = json(v.nval);
-                    else if (v.type == Value::Type::BOOL)
-                        env.current_object->operator[](as->name) = json(v.bval);
-                    else
-                        env.current_object->operator[](as->name) = json(v.sval);
+                    env.current_object->operator[](as->name) = v.toJson();
                     env.declared_fields.insert(as->name);
                 }
             }
@@ -169,6 +223,8 @@ void Interpreter::execStmt(Stmt *s)
                     v = Value::makeStr("");
                 else if (ds->type == "bool")
                     v = Value::makeBool(false);
+                else if (ds->type == "arr")
+                    v = Value::makeArr(std::make_shared<Array>());
             }
         }
         else if (ds->init.has_value())
@@ -184,19 +240,15 @@ void Interpreter::execStmt(Stmt *s)
                 v = Value::makeStr("");
             else if (ds->type == "bool")
                 v = Value::makeBool(false);
+            else if (ds->type == "arr")
+                v = Value::makeArr(std::make_shared<Array>());
         }
         
         // If inside object, write to object field, else to var
         if (env.current_object.has_value())
         {
-            if (v.type == Value::Type::NUM && v.isInteger)
-                env.current_object->operator[](ds->name) = json(static_cast<ll>(v.nval));
-            else if (v.type == Value::Type::NUM)
-                env.current_object->operator[](ds->name) = json(v.nval);
-            else if (v.type == Value::Type::BOOL)
-                env.current_object->operator[](ds->name) = json(v.bval);
-            else
-                env.current_object->operator[](ds->name) = json(v.sval);
+            ALLOC_PHASE(JSON_BUILD);
+            env.current_object->operator[](ds->name) = v.toJson();
             env.declared_fields.insert(ds->name);
         }
         else
@@ -239,128 +291,111 @@ void Interpreter::execStmt(Stmt *s)
     
     if (auto fs = dynamic_cast<ForStmt *>(s))
     {
-        ll start = 1, end = 1, step = 1;
-        
-        if (fs->args.size() == 1)
-        {
-            // for(i, N) -> i from 1 to N
-            end = evalExpr(fs->args[0].get()).toInt();
-        }
-        else if (fs->args.size() == 2)
-        {
-            // for(i, start, end) -> i from start to end
-            start = evalExpr(fs->args[0].get()).toInt();
-            end = evalExpr(fs->args[1].get()).toInt();
-        }
-        else if (fs->args.size() == 3)
+        execFor(fs);
+        return;
+    }
+    
+    if (auto os = dynamic_cast<ObjStmt *>(s))
+    {
         {
-            // for(i, start, end, step)
-            start = evalExpr(fs->args[0].get()).toInt();
-            end = evalExpr(fs->args[1].get()).toInt();
-            step = evalExpr(fs->args[2].get()).toInt();
+            ALLOC_PHASE(JSON_BUILD);
+            // Create object, bulk-copying pre-evaluated prototype fields if any
+            if (!os->proto.empty())
+            {
+                const Prototype &proto = env.getPrototype(os->proto);
+                env.current_object = proto.fields;
+                env.declared_fields = proto.names;
+            }
+            else
+            {
+                env.current_object = json::object();
+                env.declared_fields.clear();
+            }
+            env.current_object->operator[]("class") = os->className;
         }
         
-        // Iterate
-        env.pushScope();
-        if (step == 0)
-            step = 1;
-        
-        if (step > 0)
+        Value idv = evalExpr(os->idExpr.get());
         {
-            for (ll it = start; it <= end; it += step)
+            ALLOC_PHASE(JSON_BUILD);
+            // ID as int if int, num if num, else string
+            if (idv.type == Value::Type::NUM)
             {
-                env.setVar(fs->iter, Value::makeInt(it));
-                try
-                {
-                    // Execute statements directly without creating additional scope
-                    for (auto &st : fs->body)
-                        execStmt(st.get());
-                }
-                catch (const BreakException&)
+                if (idv.isInteger)
                 {
-                    break;
-                }
-                catch (const ContinueException&)
-                {
-                    continue;
+                    env.current_object->operator[]("id") = static_cast<ll>(idv.nval);
                 }
-                catch (...)
+                else
                 {
-                    env.popScope();
-                    throw;
+                    env.current_object->operator[]("id") = idv.nval;
                 }
             }
-        }
-        else
-        {
-            for (ll it = start; it >= end; it += step)
+            else
             {
-                env.setVar(fs->iter, Value::makeInt(it));
-                try
-                {
-                    // Execute statements directly without creating additional scope
-                    for (auto &st : fs->body)
-                        execStmt(st.get());
-                }
-                catch (const BreakException&)
-                {
-                    break;
-                }
-                catch (const ContinueException&)
-                {
-                    continue;
-                }
-                catch (...)
-                {
-                    env.popScope();
-                    throw;
-                }
+                env.current_object->operator[]("id") = idv.toStr();
             }
         }
+        
+        // Execute body with object context; use new scope for body variables
+        env.pushScope();
+        for (auto &st : os->body)
+        {
+            execStmt(st.get());
+        }
         env.popScope();
+        
+        // Push to output
+        {
+            ALLOC_PHASE(JSON_BUILD);
+            env.output.push_back(*env.current_object);
+            env.current_object.reset();
+            env.declared_fields.clear();
+        }
         return;
     }
     
-    if (auto os = dynamic_cast<ObjStmt *>(s))
+    if (auto ps = dynamic_cast<ProtoStmt *>(s))
     {
-        // Create object
-        env.current_object = json::object();
-        env.declared_fields.clear();
-        env.current_object->operator[]("class") = os->className;
+        if (env.current_object.has_value())
+            throw std::runtime_error("Prototype '" + ps->name + "' cannot be defined inside an object");
         
-        Value idv = evalExpr(os->idExpr.get());
-        // ID as int if int, num if num, else string
-        if (idv.type == Value::Type::NUM)
+        // Evaluate the prototype body once, like an object body
+        Prototype proto;
+        if (!ps->parent.empty())
+            proto = env.getPrototype(ps->parent);
+        env.current_object = std::move(proto.fields);
+        env.declared_fields = std::move(proto.names);
+        
+        env.pushScope();
+        try
         {
-            if (idv.isInteger)
-            {
-                env.current_object->operator[]("id") = static_cast<ll>(idv.nval);
-            }
-            else
+            for (auto &st : ps->body)
             {
-                env.current_object->operator[]("id") = idv.nval;
+                execStmt(st.get());
             }
         }
-        else
-        {
-            env.current_object->operator[]("id") = idv.toStr();
-        }
-        
-        // Execute body with object context; use new scope for body variables
-        env.pushScope();
-        for (auto &st : os->body)
+        catch (...)
         {
-            execStmt(st.get());
+            env.popScope();
+            env.current_object.reset();
+            env.declared_fields.clear();
+            throw;
         }
         env.popScope();
         
-        // Push to output
-        env.output.push_back(*env.current_object);
+        proto.fields = std::move(*env.current_object);
+        proto.names = std::move(env.declared_fields);
+        env.prototypes[ps->name] = std::move(proto);
         env.current_object.reset();
         env.declared_fields.clear();
         return;
     }
     
+    if (auto fn = dynamic_cast<FnStmt *>(s))
+    {
+        defineFunction(fn);
+        return;
+    }
+    
     if (auto bs = dynamic_cast<BreakStmt *>(s))
     {
         // 执行break语句块中的语句
@@ -436,6 +471,12 @@ Value Interpreter::execBlockWithReturn(const std::vector<StmtPtr> &body)
                 lastValue = evalExpr(exprStmt->expr.get());
                 hasValue = true;
             }
+            else if (auto ifStmt = dynamic_cast<IfStmt*>(stmt.get()))
+            {
+                // Last statement is an if, return the value of the taken branch
+                lastValue = execIfWithReturn(ifStmt);
+                hasValue = true;
+            }
             else
             {
                 execStmt(stmt.get());
@@ -0,0 +1,129 @@
+#include "interpreter.h"
+#include "parser.h"
+#include "alloc_stats.h"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // 解析线程最多领先执行的顶层语句数, 限制排队中的 AST 占用的内存
+    constexpr size_t STREAM_QUEUE_CAPACITY = 64;
+
+    // 统计节点数, 并检查是否定义了函数: 语句执行后 functions 仍然引用其中的 FnStmt
+    void inspect(Node *n, size_t &nodes, bool &definesFunction)
+    {
+        ++nodes;
+        if (dynamic_cast<FnStmt *>(n))
+            definesFunction = true;
+        forEachChild(n, [&](Node *child)
+                     { inspect(child, nodes, definesFunction); });
+    }
+
+    // Bounded statement queue 解析线程和执行线程之间的有界队列
+    class StatementQueue
+    {
+    public:
+        // 队列已满时等待; 执行线程已放弃时返回 false
+        bool push(StmtPtr stmt)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [&]()
+                         { return items.size() < STREAM_QUEUE_CAPACITY || cancelled; });
+            if (cancelled)
+                return false;
+            items.push_back(std::move(stmt));
+            notEmpty.notify_one();
+            return true;
+        }
+
+        // 解析结束, error 非空表示解析出错
+        void finish(std::exception_ptr e)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            error = e;
+            notEmpty.notify_one();
+        }
+
+        // 取出下一条语句; 队列耗尽时返回 nullptr, 解析出错时抛出该错误
+        StmtPtr pop()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            notEmpty.wait(lock, [&]()
+                          { return !items.empty() || done; });
+            if (items.empty())
+            {
+                if (error)
+                    std::rethrow_exception(error);
+                return nullptr;
+            }
+            StmtPtr stmt = std::move(items.front());
+            items.pop_front();
+            notFull.notify_one();
+            return stmt;
+        }
+
+        void cancel()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+            notFull.notify_one();
+        }
+
+    private:
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+        std::deque<StmtPtr> items;
+        bool done = false;
+        bool cancelled = false;
+        std::exception_ptr error;
+    };
+}
+
+size_t Interpreter::executeStream(Parser &parser)
+{
+    if (profiler || tracer || nodeStats || scriptStack)
+        throw std::runtime_error("Streaming execution cannot be combined with profiling, tracing, node statistics or sampling");
+
+    StatementQueue queue;
+    std::thread producer([&]()
+                         {
+        try
+        {
+            while (StmtPtr stmt = parser.parseNextStmt())
+                if (!queue.push(std::move(stmt)))
+                    return;
+            queue.finish(nullptr);
+        }
+        catch (...)
+        {
+            queue.finish(std::current_exception());
+        } });
+
+    ALLOC_PHASE(EXECUTE);
+    size_t nodes = 0;
+    try
+    {
+        while (StmtPtr stmt = queue.pop())
+        {
+            execTopLevel(stmt.get());
+            bool definesFunction = false;
+            inspect(stmt.get(), nodes, definesFunction);
+            if (definesFunction)
+                retainedStmts.push_back(std::move(stmt));
+        }
+    }
+    catch (...)
+    {
+        queue.cancel();
+        producer.join();
+        throw;
+    }
+    producer.join();
+    return nodes;
+}
@@ -1,217 +1,304 @@
 #include "lexer.h"
-#include <cctype>
+#include "alloc_stats.h"
+#include "lexer_scan.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <stdexcept>
 
-Token::Token(TokenKind k, std::string t, int l) : kind(k), text(std::move(t)), line(l) {}
-
-Lexer::Lexer(std::string s) : src(std::move(s)) {}
-
-char Lexer::peek() const
+namespace
 {
-    if (i < src.size())
-        return src[i];
-    return '\0';
-}
+    // 超过这个长度的空白交给向量化扫描
+    constexpr size_t SHORT_BLANK_RUN = 8;
 
-char Lexer::get()
-{
-    if (i < src.size())
-        return src[i++];
-    return '\0';
-}
+    // Character classes 字符类别, 由 256 项的表决定 nextToken 的分派
+    enum class CharClass : std::uint8_t
+    {
+        OTHER, // 未知字符
+        BLANK, // 空格、制表符、'\r'、'\n'
+        IDENT, // 字母和下划线
+        DIGIT,
+        QUOTE,
+        PUNCT, // 符号和运算符
+    };
 
-void Lexer::skipWhitespace()
-{
-    while (true)
+    struct CharInfo
     {
-        char c = peek();
-        if (c == ' ' || c == '\t' || c == '\r')
-        {
-            get();
-        }
-        else if (c == '\n')
-        {
-            get();
-            line++;
-        }
-        else if (c == '/' && i + 1 < src.size() && src[i + 1] == '/')
-        {
-            // 跳过注释
-            while (peek() != '\n' && peek() != '\0')
-                get();
-        }
-        else
+        CharClass cls = CharClass::OTHER;
+        TokenKind single = TokenKind::UNKNOWN; // 单字符 token
+        char second = '\0';                    // 组成双字符 token 的第二个字符
+        TokenKind pair = TokenKind::UNKNOWN;   // 双字符 token
+    };
+
+    constexpr std::array<CharInfo, 256> makeCharTable()
+    {
+        std::array<CharInfo, 256> t{};
+        for (int c = 'a'; c <= 'z'; ++c)
+            t[c].cls = CharClass::IDENT;
+        for (int c = 'A'; c <= 'Z'; ++c)
+            t[c].cls = CharClass::IDENT;
+        t['_'].cls = CharClass::IDENT;
+        for (int c = '0'; c <= '9'; ++c)
+            t[c].cls = CharClass::DIGIT;
+        t[' '].cls = t['\t'].cls = t['\r'].cls = t['\n'].cls = CharClass::BLANK;
+        t['"'].cls = CharClass::QUOTE;
+
+        struct Punct
         {
-            break;
-        }
+            char c;
+            TokenKind single;
+            char second;
+            TokenKind pair;
+        };
+        constexpr Punct puncts[] = {
+            {'(', TokenKind::LPAREN, '\0', TokenKind::UNKNOWN},
+            {')', TokenKind::RPAREN, '\0', TokenKind::UNKNOWN},
+            {'{', TokenKind::LBRACE, '\0', TokenKind::UNKNOWN},
+            {'}', TokenKind::RBRACE, '\0', TokenKind::UNKNOWN},
+            {'[', TokenKind::LBRACKET, '\0', TokenKind::UNKNOWN},
+            {']', TokenKind::RBRACKET, '\0', TokenKind::UNKNOWN},
+            {',', TokenKind::COMMA, '\0', TokenKind::UNKNOWN},
+            {':', TokenKind::COLON, '\0', TokenKind::UNKNOWN},
+            {';', TokenKind::SEMI, '\0', TokenKind::UNKNOWN},
+            {'.', TokenKind::DOT, '\0', TokenKind::UNKNOWN},
+            {'+', TokenKind::PLUS, '\0', TokenKind::UNKNOWN},
+            {'-', TokenKind::MINUS, '\0', TokenKind::UNKNOWN},
+            {'*', TokenKind::MUL, '\0', TokenKind::UNKNOWN},
+            {'/', TokenKind::DIV, '\0', TokenKind::UNKNOWN}, // 注释已在 skipWhitespace 中跳过
+            {'%', TokenKind::MOD, '\0', TokenKind::UNKNOWN},
+            {'=', TokenKind::ASSIGN, '=', TokenKind::EQ},
+            {'!', TokenKind::NOT, '=', TokenKind::NEQ},
+            {'<', TokenKind::LT, '=', TokenKind::LE},
+            {'>', TokenKind::GT, '=', TokenKind::GE},
+            {'&', TokenKind::UNKNOWN, '&', TokenKind::AND}, // 单独的 '&' / '|' 是未知 token
+            {'|', TokenKind::UNKNOWN, '|', TokenKind::OR},
+        };
+        for (auto &p : puncts)
+            t[static_cast<unsigned char>(p.c)] = {CharClass::PUNCT, p.single, p.second, p.pair};
+        return t;
     }
-}
 
-Token Lexer::nextToken()
-{
-    skipWhitespace();
-    char c = peek();
-    // 结束Token
-    if (c == '\0')
-        return Token(TokenKind::END, "", line);
+    constexpr std::array<CharInfo, 256> charTable = makeCharTable();
 
-    // 单字符Token
-    if (c == '(')
+    inline const CharInfo &charInfo(char c)
     {
-        get();
-        return Token(TokenKind::LPAREN, "(", line);
-    }
-    if (c == ')')
-    {
-        get();
-        return Token(TokenKind::RPAREN, ")", line);
+        return charTable[static_cast<unsigned char>(c)];
     }
-    if (c == '{')
+
+    inline bool isIdentChar(char c)
     {
-        get();
-        return Token(TokenKind::LBRACE, "{", line);
+        CharClass cls = charInfo(c).cls;
+        return cls == CharClass::IDENT || cls == CharClass::DIGIT;
     }
-    if (c == '}')
+
+    inline bool isDigit(char c)
     {
-        get();
-        return Token(TokenKind::RBRACE, "}", line);
+        return charInfo(c).cls == CharClass::DIGIT;
     }
-    if (c == ',')
+
+    // Keywords 保留字, 用编译期生成的完美哈希识别
+    struct Keyword
     {
-        get();
-        return Token(TokenKind::COMMA, ",", line);
-    }
-    if (c == ';')
+        std::string_view text;
+        TokenKind kind;
+    };
+
+    constexpr Keyword keywords[] = {
+        {"if", TokenKind::KW_IF},
+        {"elif", TokenKind::KW_ELIF},
+        {"else", TokenKind::KW_ELSE},
+        {"for", TokenKind::KW_FOR},
+        {"obj", TokenKind::KW_OBJ},
+        {"fn", TokenKind::KW_FN},
+        {"proto", TokenKind::KW_PROTO},
+        {"num", TokenKind::KW_NUM},
+        {"str", TokenKind::KW_STR},
+        {"bool", TokenKind::KW_BOOL},
+        {"arr", TokenKind::KW_ARR},
+        {"break", TokenKind::KW_BREAK},
+        {"continue", TokenKind::KW_CONTINUE},
+        {"true", TokenKind::KW_TRUE},
+        {"false", TokenKind::KW_FALSE},
+    };
+    constexpr size_t KEYWORD_COUNT = sizeof(keywords) / sizeof(keywords[0]);
+    constexpr size_t KEYWORD_TABLE_SIZE = 32; // 2 的幂
+    constexpr size_t KEYWORD_MIN_LEN = 2;
+    constexpr size_t KEYWORD_MAX_LEN = 8;
+
+    // 哈希只用首字符、末字符和长度(所有保留字的这三项互不相同), 乘数在编译期搜索
+    constexpr size_t keywordHash(std::string_view s, std::uint32_t seed)
     {
-        get();
-        return Token(TokenKind::SEMI, ";", line);
+        std::uint32_t h = static_cast<unsigned char>(s[0]) * 31u + static_cast<unsigned char>(s[s.size() - 1]);
+        return ((h * seed) >> 8 ^ static_cast<std::uint32_t>(s.size())) & (KEYWORD_TABLE_SIZE - 1);
     }
-    if (c == '.')
+
+    constexpr bool seedIsPerfect(std::uint32_t seed)
     {
-        get();
-        return Token(TokenKind::DOT, ".", line);
+        bool used[KEYWORD_TABLE_SIZE] = {};
+        for (auto &kw : keywords)
+        {
+            size_t h = keywordHash(kw.text, seed);
+            if (used[h])
+                return false;
+            used[h] = true;
+        }
+        return true;
     }
-    if (c == '+')
+
+    constexpr std::uint32_t findKeywordSeed()
     {
-        get();
-        return Token(TokenKind::PLUS, "+", line);
+        for (std::uint32_t seed = 1; seed < 100000; ++seed)
+            if (seedIsPerfect(seed))
+                return seed;
+        return 0;
     }
-    if (c == '-')
+
+    constexpr std::uint32_t KEYWORD_SEED = findKeywordSeed();
+    static_assert(KEYWORD_SEED != 0, "no perfect hash seed for the keyword set");
+
+    // 哈希槽 -> keywords 下标, 空槽为 -1
+    constexpr std::array<std::int8_t, KEYWORD_TABLE_SIZE> makeKeywordTable()
     {
-        get();
-        return Token(TokenKind::MINUS, "-", line);
+        std::array<std::int8_t, KEYWORD_TABLE_SIZE> t{};
+        for (auto &slot : t)
+            slot = -1;
+        for (size_t k = 0; k < KEYWORD_COUNT; ++k)
+            t[keywordHash(keywords[k].text, KEYWORD_SEED)] = static_cast<std::int8_t>(k);
+        return t;
     }
-    if (c == '*')
+
+    constexpr std::array<std::int8_t, KEYWORD_TABLE_SIZE> keywordTable = makeKeywordTable();
+
+    // 一次哈希、一次查表、一次比较
+    inline TokenKind identKind(std::string_view s)
     {
-        get();
-        return Token(TokenKind::MUL, "*", line);
+        if (s.size() < KEYWORD_MIN_LEN || s.size() > KEYWORD_MAX_LEN)
+            return TokenKind::IDENT;
+        int k = keywordTable[keywordHash(s, KEYWORD_SEED)];
+        return k >= 0 && keywords[k].text == s ? keywords[k].kind : TokenKind::IDENT;
     }
-    if (c == '/')
+}
+
+Token::Token(TokenKind k, std::string_view t, int l) : kind(k), text(t), line(l) {}
+
+std::string_view TokenBuffer::text(size_t i) const
+{
+    i = clamp(i);
+    std::uint32_t offset = offsets[i];
+    if (offset & EXTRA_BIT)
+        return std::string_view(extra).substr(offset & ~EXTRA_BIT, lengths[i]);
+    return src.substr(offset, lengths[i]);
+}
+
+void TokenBuffer::push(const Token &t)
+{
+    std::uint32_t offset;
+    const char *p = t.text.data();
+    if (t.text.empty() || (p >= src.data() && p + t.text.size() <= src.data() + src.size()))
     {
-        get();
-        return Token(TokenKind::DIV, "/", line);
+        offset = t.text.empty() ? 0 : static_cast<std::uint32_t>(p - src.data());
     }
-    if (c == '%')
+    else
     {
-        get();
-        return Token(TokenKind::MOD, "%", line);
+        // 解码后的字符串不在源代码中
+        offset = static_cast<std::uint32_t>(extra.size()) | EXTRA_BIT;
+        extra.append(t.text);
     }
+    kinds.push_back(static_cast<std::uint8_t>(t.kind));
+    offsets.push_back(offset);
+    lengths.push_back(static_cast<std::uint32_t>(t.text.size()));
+    lines.push_back(t.line);
+}
+
+Lexer::Lexer(std::string_view s, int firstLine) : src(s), line(firstLine) {}
+
+std::string_view Lexer::slice(size_t start) const
+{
+    return src.substr(start, i - start);
+}
+
+char Lexer::peek() const
+{
+    if (i < src.size())
+        return src[i];
+    return '\0';
+}
+
+char Lexer::get()
+{
+    if (i < src.size())
+        return src[i++];
+    return '\0';
+}
 
-    // 双字符Token
-    if (c == '=')
+void Lexer::skipWhitespace()
+{
+    const char *s = src.data();
+    size_t n = src.size();
+    while (i < n)
     {
-        get();
-        if (peek() == '=')
+        char c = s[i];
+        if (charInfo(c).cls == CharClass::BLANK)
         {
-            get();
-            return Token(TokenKind::EQ, "==", line);
+            // 短的空白(token 之间的空格、少量缩进)逐字节处理, 较长的空白批量跳过并统计换行
+            size_t limit = std::min(n, i + SHORT_BLANK_RUN);
+            do
+            {
+                if (s[i] == '\n')
+                    line++;
+                i++;
+            } while (i < limit && charInfo(s[i]).cls == CharClass::BLANK);
+            if (i == limit && i < n)
+                i = scanBlank(s, i, n, line);
         }
-        return Token(TokenKind::ASSIGN, "=", line); // TODO 这里有赋值符号的token
-    }
-    if (c == '!')
-    {
-        get();
-        if (peek() == '=')
+        else if (c == '/' && i + 1 < n && s[i + 1] == '/')
         {
-            get();
-            return Token(TokenKind::NEQ, "!=", line);
+            // 跳过注释, 结尾的换行在下一轮统计
+            i = scanNewline(s, i + 2, n);
         }
-        return Token(TokenKind::NOT, "!", line);
-    }
-    if (c == '<')
-    {
-        get();
-        if (peek() == '=')
+        else
         {
-            get();
-            return Token(TokenKind::LE, "<=", line);
+            break;
         }
-        return Token(TokenKind::LT, "<", line);
     }
-    if (c == '>')
+}
+
+Token Lexer::nextToken()
+{
+    ALLOC_PHASE(LEX);
+    skipWhitespace();
+    size_t start = i;
+    char c = peek();
+    // 结束Token
+    if (c == '\0')
+        return Token(TokenKind::END, {}, line);
+
+    const CharInfo &info = charInfo(c);
+    switch (info.cls)
     {
+    case CharClass::PUNCT:
         get();
-        if (peek() == '=')
+        // 双字符Token
+        if (info.second != '\0' && peek() == info.second)
         {
             get();
-            return Token(TokenKind::GE, ">=", line);
+            return Token(info.pair, slice(start), line);
         }
-        return Token(TokenKind::GT, ">", line);
-    }
-    if (c == '&' && i + 1 < src.size() && src[i + 1] == '&')
-    {
-        get();
-        get();
-        return Token(TokenKind::AND, "&&", line);
-    }
-    if (c == '|' && i + 1 < src.size() && src[i + 1] == '|')
-    {
-        get();
-        get();
-        return Token(TokenKind::OR, "||", line);
-    }
+        return Token(info.single, slice(start), line);
 
     // 标识符或保留字
-    if (std::isalpha(c) || c == '_')
+    case CharClass::IDENT:
     {
-        std::string s;
-        while (std::isalnum(peek()) || peek() == '_')
-            s.push_back(get());
-
-        // 检查保留字
-        if (s == "if")
-            return Token(TokenKind::KW_IF, s, line);
-        if (s == "elif")
-            return Token(TokenKind::KW_ELIF, s, line);
-        if (s == "else")
-            return Token(TokenKind::KW_ELSE, s, line);
-        if (s == "for")
-            return Token(TokenKind::KW_FOR, s, line);
-        if (s == "obj")
-            return Token(TokenKind::KW_OBJ, s, line);
-        if (s == "num")
-            return Token(TokenKind::KW_NUM, s, line);
-        if (s == "str")
-            return Token(TokenKind::KW_STR, s, line);
-        if (s == "bool")
-            return Token(TokenKind::KW_BOOL, s, line);
-        if (s == "break")
-            return Token(TokenKind::KW_BREAK, s, line);
-        if (s == "continue")
-            return Token(TokenKind::KW_CONTINUE, s, line);
-        if (s == "true")
-            return Token(TokenKind::KW_TRUE, s, line);
-        if (s == "false")
-            return Token(TokenKind::KW_FALSE, s, line);
-
-        return Token(TokenKind::IDENT, s, line);
+        while (isIdentChar(peek()))
+            get();
+        std::string_view s = slice(start);
+        return Token(identKind(s), s, line);
     }
 
-    // Numbers
-    if (std::isdigit(c))
+    case CharClass::DIGIT:
     {
-        std::string s;
-        while (std::isdigit(peek()))
-            s.push_back(get());
+        while (isDigit(peek()))
+            get();
 
         // 检查是否有小数点
         if (peek() == '.')
@@ -220,12 +307,11 @@ Token Lexer::nextToken()
             size_t saved_pos = i;
             get(); // 消费小数点
 
-            if (std::isdigit(peek()))
+            if (isDigit(peek()))
             {
-                // 有效的小数, 添加小数点和小数部分
-                s.push_back('.');
-                while (std::isdigit(peek()))
-                    s.push_back(get());
+                // 有效的小数, 包含小数点和小数部分
+                while (isDigit(peek()))
+                    get();
             }
             else
             {
@@ -234,19 +320,36 @@ Token Lexer::nextToken()
             }
         }
 
-        return Token(TokenKind::NUMBER, s, line);
+        return Token(TokenKind::NUMBER, slice(start), line);
     }
 
-    // Strings
-    if (c == '"')
+    case CharClass::QUOTE:
     {
         get(); // 消费 "
-        std::string s;
+        size_t body = i;
+        // 没有转义字符的字符串直接引用源代码
+        while (i < src.size() && src[i] != '"' && src[i] != '\\' && src[i] != '\0')
+            i++;
+        if (peek() == '\0')
+        {
+            std::string_view s = slice(body);
+            get();
+            return Token(TokenKind::UNKNOWN, s, line);
+        }
+        if (src[i] == '"')
+        {
+            std::string_view s = slice(body);
+            get();
+            return Token(TokenKind::STRING, s, line);
+        }
+
+        // 含转义字符时把解码结果保存在词法分析器中
+        std::string s(src.substr(body, i - body));
         while (true)
         {
             char ch = get();
             if (ch == '\0')
-                return Token(TokenKind::UNKNOWN, s, line);
+                return Token(TokenKind::UNKNOWN, unescaped.emplace_back(std::move(s)), line);
             if (ch == '"')
                 break;
             if (ch == '\\')
@@ -268,10 +371,36 @@ Token Lexer::nextToken()
                 s.push_back(ch);
             }
         }
-        return Token(TokenKind::STRING, s, line);
+        return Token(TokenKind::STRING, unescaped.emplace_back(std::move(s)), line);
+    }
+
+    default:
+        // 未知Token
+        get();
+        return Token(TokenKind::UNKNOWN, slice(start), line);
     }
+}
 
-    // 未知Token
-    get();
-    return Token(TokenKind::UNKNOWN, std::string(1, c), line);
-}
\ No newline at end of file
+TokenBuffer Lexer::tokenizeAll()
+{
+    ALLOC_PHASE(LEX);
+    if (src.size() >= TokenBuffer::EXTRA_BIT)
+        throw std::runtime_error("Script is too large (2 GiB limit)");
+
+    TokenBuffer buf;
+    buf.src = src;
+    // 按平均每 4 个字节一个 token 预留
+    size_t expected = (src.size() - i) / 4 + 1;
+    buf.kinds.reserve(expected);
+    buf.offsets.reserve(expected);
+    buf.lengths.reserve(expected);
+    buf.lines.reserve(expected);
+    while (true)
+    {
+        Token t = nextToken();
+        buf.push(t);
+        if (t.kind == TokenKind::END)
+            break;
+    }
+    return buf;
+}
@@ -0,0 +1,228 @@
+#include "lexer_scan.h"
+#include <cstdint>
+#include <stdexcept>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#include <emmintrin.h>
+#define LUDUS_SCAN_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#include <immintrin.h>
+#define LUDUS_SCAN_AVX2 1 // 以 target 属性单独编译, 运行时检测
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    inline bool isBlank(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    inline unsigned lowestBit(std::uint32_t x)
+    {
+#ifdef _MSC_VER
+        unsigned long idx;
+        _BitScanForward(&idx, x);
+        return static_cast<unsigned>(idx);
+#else
+        return static_cast<unsigned>(__builtin_ctz(x));
+#endif
+    }
+
+    inline int bitCount(std::uint32_t x)
+    {
+#ifdef _MSC_VER
+        x = x - ((x >> 1) & 0x55555555u);
+        x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+        return static_cast<int>((((x + (x >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24);
+#else
+        return __builtin_popcount(x);
+#endif
+    }
+
+    // Scalar implementation 逐字节实现, 也用于向量实现末尾不足一个向量的部分
+    size_t scanBlankScalar(const char *s, size_t i, size_t n, int &newlines)
+    {
+        while (i < n && isBlank(s[i]))
+        {
+            if (s[i] == '\n')
+                ++newlines;
+            ++i;
+        }
+        return i;
+    }
+
+    size_t scanNewlineScalar(const char *s, size_t i, size_t n)
+    {
+        while (i < n && s[i] != '\n')
+            ++i;
+        return i;
+    }
+
+#ifdef LUDUS_SCAN_SSE2
+    size_t scanBlankSse2(const char *s, size_t i, size_t n, int &newlines)
+    {
+        const __m128i space = _mm_set1_epi8(' ');
+        const __m128i tab = _mm_set1_epi8('\t');
+        const __m128i cr = _mm_set1_epi8('\r');
+        const __m128i nl = _mm_set1_epi8('\n');
+        while (i + 16 <= n)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+            __m128i isNl = _mm_cmpeq_epi8(v, nl);
+            __m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, tab)),
+                                         _mm_or_si128(_mm_cmpeq_epi8(v, cr), isNl));
+            std::uint32_t nlMask = static_cast<std::uint32_t>(_mm_movemask_epi8(isNl));
+            std::uint32_t other = ~static_cast<std::uint32_t>(_mm_movemask_epi8(blank)) & 0xFFFFu;
+            if (other)
+            {
+                unsigned pos = lowestBit(other);
+                newlines += bitCount(nlMask & ((1u << pos) - 1));
+                return i + pos;
+            }
+            newlines += bitCount(nlMask);
+            i += 16;
+        }
+        return scanBlankScalar(s, i, n, newlines);
+    }
+
+    size_t scanNewlineSse2(const char *s, size_t i, size_t n)
+    {
+        const __m128i nl = _mm_set1_epi8('\n');
+        while (i + 16 <= n)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i));
+            std::uint32_t mask = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, nl)));
+            if (mask)
+                return i + lowestBit(mask);
+            i += 16;
+        }
+        return scanNewlineScalar(s, i, n);
+    }
+#endif
+
+#ifdef LUDUS_SCAN_AVX2
+    __attribute__((target("avx2"))) size_t scanBlankAvx2(const char *s, size_t i, size_t n, int &newlines)
+    {
+        const __m256i space = _mm256_set1_epi8(' ');
+        const __m256i tab = _mm256_set1_epi8('\t');
+        const __m256i cr = _mm256_set1_epi8('\r');
+        const __m256i nl = _mm256_set1_epi8('\n');
+        while (i + 32 <= n)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+            __m256i isNl = _mm256_cmpeq_epi8(v, nl);
+            __m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, tab)),
+                                            _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), isNl));
+            std::uint32_t nlMask = static_cast<std::uint32_t>(_mm256_movemask_epi8(isNl));
+            std::uint32_t other = ~static_cast<std::uint32_t>(_mm256_movemask_epi8(blank));
+            if (other)
+            {
+                unsigned pos = lowestBit(other);
+                newlines += bitCount(nlMask & ((1u << pos) - 1));
+                return i + pos;
+            }
+            newlines += bitCount(nlMask);
+            i += 32;
+        }
+        return scanBlankSse2(s, i, n, newlines);
+    }
+
+    __attribute__((target("avx2"))) size_t scanNewlineAvx2(const char *s, size_t i, size_t n)
+    {
+        const __m256i nl = _mm256_set1_epi8('\n');
+        while (i + 32 <= n)
+        {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i));
+            std::uint32_t mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl)));
+            if (mask)
+                return i + lowestBit(mask);
+            i += 32;
+        }
+        return scanNewlineSse2(s, i, n);
+    }
+
+    bool cpuHasAvx2()
+    {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2");
+    }
+#endif
+
+    struct ScanImpl
+    {
+        const char *name;
+        size_t (*blank)(const char *, size_t, size_t, int &);
+        size_t (*newline)(const char *, size_t, size_t);
+    };
+
+    const ScanImpl scalarImpl = {"scalar", scanBlankScalar, scanNewlineScalar};
+#ifdef LUDUS_SCAN_SSE2
+    const ScanImpl sse2Impl = {"sse2", scanBlankSse2, scanNewlineSse2};
+#endif
+#ifdef LUDUS_SCAN_AVX2
+    const ScanImpl avx2Impl = {"avx2", scanBlankAvx2, scanNewlineAvx2};
+#endif
+
+    const ScanImpl *bestImpl()
+    {
+#ifdef LUDUS_SCAN_AVX2
+        if (cpuHasAvx2())
+            return &avx2Impl;
+#endif
+#ifdef LUDUS_SCAN_SSE2
+        return &sse2Impl;
+#else
+        return &scalarImpl;
+#endif
+    }
+
+    const ScanImpl *&activeImpl()
+    {
+        static const ScanImpl *impl = bestImpl();
+        return impl;
+    }
+}
+
+size_t scanBlank(const char *s, size_t i, size_t n, int &newlines)
+{
+    return activeImpl()->blank(s, i, n, newlines);
+}
+
+size_t scanNewline(const char *s, size_t i, size_t n)
+{
+    return activeImpl()->newline(s, i, n);
+}
+
+const char *scanImplementation()
+{
+    return activeImpl()->name;
+}
+
+void setScanImplementation(const std::string &name)
+{
+    if (name == "scalar")
+    {
+        activeImpl() = &scalarImpl;
+        return;
+    }
+#ifdef LUDUS_SCAN_SSE2
+    if (name == "sse2")
+    {
+        activeImpl() = &sse2Impl;
+        return;
+    }
+#endif
+#ifdef LUDUS_SCAN_AVX2
+    if (name == "avx2" && cpuHasAvx2())
+    {
+        activeImpl() = &avx2Impl;
+        return;
+    }
+#endif
+    throw std::runtime_error("Scan implementation '" + name + "' is not available on this CPU");
+}
@@ -1,39 +1,341 @@
 #include "parser.h"
 #include "interpreter.h"
+#include "profiler.h"
+#include "tracer.h"
+#include "stats.h"
+#include "node_stats.h"
+#include "sampler.h"
+#include "source_file.h"
+#include "ast_cache.h"
+#include "server.h"
 #include <iostream>
+#include <filesystem>
 #include <fstream>
-#include <sstream>
 #include <string>
+#include <optional>
+#include <vector>
 
-int main_inner(const std::string &source, bool printPretty, const std::string &outputFile = "")
+// Command line options 命令行选项
+struct Options
+{
+    std::string scriptPath;
+    bool pretty = false;
+    std::string outputFile;
+    unsigned threads = 0;   // 0 = 硬件线程数
+    std::optional<ll> index; // --index k: 只生成第 k 个对象
+    bool profile = false;
+    std::string traceFile;  // --trace: Chrome trace-event 输出
+    ll traceSample = 1;     // 每 N 个对象记录一个事件
+    bool stats = false;
+    bool nodeStats = false;
+    std::string flameFile; // --flame: 折叠栈输出
+    int flameHz = 999;
+    bool stream = false;   // --stream: 边解析边执行
+    std::string cacheDir;  // --cache-dir: 编译缓存目录
+    std::string snapshotFile; // --snapshot-after-prelude: 前导段快照
+    std::vector<std::pair<std::string, std::string>> params; // --param name=value, 前导段之后赋值
+};
+
+// Times one phase for --trace and --stats 阶段计时
+class PhaseScope
+{
+public:
+    PhaseScope(Tracer *t, RunStats *s, const char *name)
+    {
+        if (t)
+            trace.emplace(*t, name);
+        if (s)
+            stat.emplace(*s, name);
+    }
+
+private:
+    std::optional<Tracer::Scope> trace;
+    std::optional<RunStats::Scope> stat;
+};
+
+// 与 base 同目录同名的附属文件: out.json -> out.profile.json
+std::string siblingPath(const std::string &base, const std::string &suffix)
+{
+    size_t slash = base.find_last_of("/\\");
+    size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        return base.substr(0, dot) + suffix;
+    return base + suffix;
+}
+
+int main_inner(std::string_view source, const Options &opts, RunStats *stats)
 {
     try
     {
-        Parser parser(source);
-        auto program = parser.parseProgram();
+        std::optional<Tracer> tracer;
+        if (!opts.traceFile.empty())
+            tracer.emplace(1 << 16, opts.traceSample);
+        Tracer *tp = tracer ? &*tracer : nullptr;
+
+        std::unique_ptr<Program> program;
+        std::optional<Parser> streamParser;
+        size_t streamedNodes = 0; // 流式执行时 AST 已释放, 节点数在执行中统计
+        if (opts.stream)
+        {
+            if (opts.index.has_value())
+                throw std::runtime_error("--stream cannot be combined with --index");
+            // 时间线事件引用 AST 中的类名, 流式执行在输出时间线之前已释放这些语句
+            if (!opts.traceFile.empty())
+                throw std::runtime_error("--stream cannot be combined with --trace");
+            // 流式执行时这里只做词法分析, 语法分析在执行阶段与执行重叠
+            PhaseScope phase(tp, stats, "lex");
+            streamParser.emplace(source);
+        }
+        else
+        {
+            std::optional<ScriptCache> cache;
+            if (!opts.cacheDir.empty())
+            {
+                cache.emplace(opts.cacheDir);
+                PhaseScope phase(tp, stats, "cache load");
+                program = cache->load(source);
+            }
+            if (!program)
+            {
+                {
+                    PhaseScope phase(tp, stats, "parse");
+                    program = parseProgram(source, opts.threads);
+                }
+                if (cache)
+                {
+                    PhaseScope phase(tp, stats, "cache store");
+                    if (!cache->store(source, *program))
+                        std::cerr << "Warning: cannot write script cache " << cache->pathFor(source) << std::endl;
+                }
+            }
+        }
 
         Interpreter interpreter;
-        interpreter.execute(program.get());
+        interpreter.setThreads(opts.threads);
+        if (tracer)
+            interpreter.setTracer(&*tracer);
+        std::optional<Profiler> profiler;
+        if (opts.profile)
+        {
+            profiler.emplace();
+            interpreter.setProfiler(&*profiler);
+        }
+        std::optional<NodeStats> nodeStats;
+        if (opts.nodeStats)
+        {
+            nodeStats.emplace();
+            interpreter.setNodeStats(&*nodeStats);
+        }
+        
+        ScriptStack scriptStack;
+        std::optional<Sampler> sampler;
+        if (!opts.flameFile.empty())
+        {
+            sampler.emplace(scriptStack);
+            interpreter.setScriptStack(&scriptStack);
+            sampler->start(opts.flameHz);
+        }
+        
+        // 前导段: 快照有效时直接恢复, 否则执行并写入快照; 参数在前导段之后赋值
+        size_t first = 0;
+        if (!opts.snapshotFile.empty() || !opts.params.empty())
+        {
+            if (streamParser)
+                throw std::runtime_error("--snapshot-after-prelude and --param cannot be combined with --stream");
+            first = Interpreter::preludeLength(program.get());
+            bool resumed = false;
+            if (!opts.snapshotFile.empty())
+            {
+                PhaseScope phase(tp, stats, "snapshot load");
+                std::error_code ec;
+                if (std::filesystem::exists(opts.snapshotFile, ec))
+                {
+                    try
+                    {
+                        SourceFile file(opts.snapshotFile);
+                        interpreter.loadSnapshot(file.view(), program.get(), source);
+                        resumed = true;
+                    }
+                    catch (const std::exception &)
+                    {
+                        // 过期或损坏的快照重新生成
+                    }
+                }
+            }
+            if (!resumed)
+            {
+                {
+                    PhaseScope phase(tp, stats, "prelude");
+                    interpreter.executeRange(program.get(), 0, first);
+                }
+                if (!opts.snapshotFile.empty())
+                {
+                    PhaseScope phase(tp, stats, "snapshot store");
+                    if (!writeFileAtomic(opts.snapshotFile, interpreter.saveSnapshot(program.get(), source)))
+                        std::cerr << "Warning: cannot write snapshot " << opts.snapshotFile << std::endl;
+                }
+            }
+            for (auto &param : opts.params)
+                interpreter.setParam(param.first, param.second);
+        }
+
+        {
+            PhaseScope phase(tp, stats, opts.stream ? "parse+execute" : "execute");
+            if (streamParser)
+                streamedNodes = interpreter.executeStream(*streamParser);
+            else if (opts.index.has_value())
+                interpreter.executeIndex(program.get(), *opts.index, first);
+            else
+                interpreter.executeRange(program.get(), first, program->stmts.size());
+        }
+        
+        if (sampler)
+        {
+            sampler->stop();
+            std::ofstream ffs(opts.flameFile);
+            if (!ffs)
+            {
+                std::cerr << "Cannot write to " << opts.flameFile << std::endl;
+                return 3;
+            }
+            std::string root = opts.scriptPath.substr(opts.scriptPath.find_last_of("/\\") + 1);
+            sampler->writeFolded(ffs, root);
+            std::cerr << "Flame graph samples: " << sampler->sampleCount();
+            if (sampler->dropped() > 0)
+                std::cerr << " (" << sampler->dropped() << " dropped, buffer full)";
+            std::cerr << ", saved to " << opts.flameFile << std::endl;
+        }
+        
+        if (profiler)
+        {
+            profiler->finish();
+            std::cerr << profiler->report(source);
+            
+            std::string profilePath = siblingPath(opts.outputFile.empty() ? opts.scriptPath : opts.outputFile, ".profile.json");
+            std::ofstream pfs(profilePath);
+            if (!pfs)
+            {
+                std::cerr << "Cannot write to " << profilePath << std::endl;
+                return 3;
+            }
+            json profileJson = profiler->toJson(source);
+            profileJson["script"] = opts.scriptPath;
+            pfs << profileJson.dump(2) << std::endl;
+            std::cerr << "Profile saved to " << profilePath << std::endl;
+        }
+
+        if (nodeStats)
+            std::cerr << nodeStats->report();
 
         // Generate output string
-        std::string jsonOutput = interpreter.getOutput(printPretty);
+        std::string jsonOutput;
+        {
+            PhaseScope phase(tp, stats, "serialize");
+            jsonOutput = interpreter.getOutput(opts.pretty);
+        }
 
-        // Output to file or console
-        if (!outputFile.empty())
+        if (tracer)
         {
-            std::ofstream ofs(outputFile);
-            if (!ofs)
+            std::ofstream tfs(opts.traceFile);
+            if (!tfs)
             {
-                std::cerr << "Cannot write to " << outputFile << std::endl;
+                std::cerr << "Cannot write to " << opts.traceFile << std::endl;
                 return 3;
             }
-            ofs << jsonOutput << std::endl;
-            std::cout << "Output saved to " << outputFile << std::endl;
+            tfs << tracer->toJson().dump() << std::endl;
+            if (tracer->dropped() > 0)
+                std::cerr << "Trace buffer full, dropped " << tracer->dropped() << " events" << std::endl;
+            std::cerr << "Trace saved to " << opts.traceFile << std::endl;
         }
-        else
+
+        // Output to file or console
+        {
+            PhaseScope phase(nullptr, stats, "write");
+            if (!opts.outputFile.empty())
+            {
+                std::ofstream ofs(opts.outputFile);
+                if (!ofs)
+                {
+                    std::cerr << "Cannot write to " << opts.outputFile << std::endl;
+                    return 3;
+                }
+                ofs << jsonOutput << std::endl;
+                std::cout << "Output saved to " << opts.outputFile << std::endl;
+            }
+            else
+            {
+                std::cout << jsonOutput << std::endl;
+            }
+        }
+
+        if (stats)
+        {
+            stats->astNodes = streamedNodes;
+            if (program)
+                for (auto &stmt : program->stmts)
+                    stats->astNodes += countNodes(stmt.get());
+            stats->objects = interpreter.objectCount();
+            stats->bytesWritten = jsonOutput.size() + 1;
+            stats->peakRssKb = RunStats::readPeakRssKb();
+            std::cerr << stats->report() << stats->toJson().dump() << std::endl;
+        }
+        return 0;
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 1;
+    }
+}
+
+// --serve <socket>: 常驻服务模式, 见 server.h
+int serve_main(int argc, char **argv)
+{
+    Server::Options opts;
+    opts.socketPath = argv[2];
+    try
+    {
+        for (int i = 3; i < argc; i++)
         {
-            std::cout << jsonOutput << std::endl;
+            std::string arg = argv[i];
+            if (arg == "--workers" && i + 1 < argc)
+            {
+                opts.workers = static_cast<unsigned>(std::stoul(argv[i + 1]));
+                i++;
+            }
+            else if (arg == "--cache-size" && i + 1 < argc)
+            {
+                opts.cacheCapacity = std::stoul(argv[i + 1]);
+                i++;
+            }
+            else if ((arg == "--threads" || arg == "-j") && i + 1 < argc)
+            {
+                opts.threads = static_cast<unsigned>(std::stoul(argv[i + 1]));
+                i++;
+            }
+            else if (arg == "--prefork" && i + 1 < argc)
+            {
+                opts.prefork = static_cast<unsigned>(std::stoul(argv[i + 1]));
+                i++;
+            }
+            else if (arg == "--preload" && i + 1 < argc)
+            {
+                opts.preload.push_back(argv[i + 1]);
+                i++;
+            }
         }
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid numeric argument" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        Server server(opts);
+        std::cerr << "Serving on " << opts.socketPath << std::endl;
+        server.run();
         return 0;
     }
     catch (const std::exception &ex)
@@ -45,43 +347,132 @@ int main_inner(const std::string &source, bool printPretty, const std::string &o
 
 int main(int argc, char **argv)
 {
-    if (argc < 2)
+    if (argc < 2 || (std::string(argv[1]) == "--serve" && argc < 3))
     {
-        std::cerr << "Usage: " << argv[0] << " <script.file> [--pretty] [--output <file.json>]\n";
+        std::cerr << "Usage: " << argv[0] << " <script.file> [--pretty] [--output <file.json>] [--threads <n>] [--index <k>] [--profile] [--trace <trace.json>] [--trace-sample <n>] [--stats] [--node-stats] [--flame <out.folded>] [--flame-hz <n>] [--stream] [--cache-dir <dir>] [--snapshot-after-prelude <file>] [--param <name=value>]\n"
+                  << "       " << argv[0] << " --serve <socket> [--workers <n> | --prefork <n>] [--preload <script>]... [--cache-size <n>] [--threads <n>]\n";
         return 1;
     }
+    if (std::string(argv[1]) == "--serve")
+        return serve_main(argc, argv);
 
-    bool pretty = false;
-    std::string outputFile = "";
+    Options opts;
     std::string path = argv[1];
+    opts.scriptPath = path;
 
     // Parse command line arguments
-    for (int i = 2; i < argc; i++)
+    try
     {
-        std::string arg = argv[i];
-        if (arg == "--pretty" || arg == "-p")
+        for (int i = 2; i < argc; i++)
         {
-            pretty = true;
+            std::string arg = argv[i];
+            if (arg == "--pretty" || arg == "-p")
+            {
+                opts.pretty = true;
+            }
+            else if ((arg == "--output" || arg == "-o") && i + 1 < argc)
+            {
+                opts.outputFile = argv[i + 1];
+                i++;
+            }
+            else if (arg.substr(0, 9) == "--output=")
+            {
+                opts.outputFile = arg.substr(9);
+            }
+            else if ((arg == "--threads" || arg == "-j") && i + 1 < argc)
+            {
+                opts.threads = static_cast<unsigned>(std::stoul(argv[i + 1]));
+                i++;
+            }
+            else if (arg == "--profile")
+            {
+                opts.profile = true;
+            }
+            else if (arg == "--stats")
+            {
+                opts.stats = true;
+            }
+            else if (arg == "--cache-dir" && i + 1 < argc)
+            {
+                opts.cacheDir = argv[i + 1];
+                i++;
+            }
+            else if (arg == "--snapshot-after-prelude" && i + 1 < argc)
+            {
+                opts.snapshotFile = argv[i + 1];
+                i++;
+            }
+            else if (arg == "--param" && i + 1 < argc)
+            {
+                std::string param = argv[i + 1];
+                size_t eq = param.find('=');
+                if (eq == std::string::npos)
+                {
+                    std::cerr << "Invalid --param '" << param << "', expected name=value" << std::endl;
+                    return 1;
+                }
+                opts.params.emplace_back(param.substr(0, eq), param.substr(eq + 1));
+                i++;
+            }
+            else if (arg == "--stream")
+            {
+                opts.stream = true;
+            }
+            else if (arg == "--node-stats")
+            {
+                opts.nodeStats = true;
+            }
+            else if (arg == "--flame" && i + 1 < argc)
+            {
+                opts.flameFile = argv[i + 1];
+                i++;
+            }
+            else if (arg == "--flame-hz" && i + 1 < argc)
+            {
+                opts.flameHz = std::stoi(argv[i + 1]);
+                i++;
+            }
+            else if (arg == "--trace" && i + 1 < argc)
+            {
+                opts.traceFile = argv[i + 1];
+                i++;
+            }
+            else if (arg == "--trace-sample" && i + 1 < argc)
+            {
+                opts.traceSample = std::stoll(argv[i + 1]);
+                i++;
+            }
+            else if ((arg == "--index" || arg == "--only-id") && i + 1 < argc)
+            {
+                opts.index = std::stoll(argv[i + 1]);
+                i++;
+            }
         }
-        else if ((arg == "--output" || arg == "-o") && i + 1 < argc)
+    }
+    catch (const std::exception &)
+    {
+        std::cerr << "Invalid numeric argument" << std::endl;
+        return 1;
+    }
+
+    std::optional<RunStats> stats;
+    if (opts.stats)
+        stats.emplace();
+    RunStats *sp = stats ? &*stats : nullptr;
+
+    // 源文件只读映射, 在整个运行期间保持有效
+    std::optional<SourceFile> src;
+    {
+        PhaseScope phase(nullptr, sp, "read");
+        try
         {
-            outputFile = argv[i + 1];
-            i++;
+            src.emplace(path);
         }
-        else if (arg.substr(0, 9) == "--output=")
+        catch (const std::exception &ex)
         {
-            outputFile = arg.substr(9);
+            std::cerr << ex.what() << std::endl;
+            return 2;
         }
     }
-
-    std::ifstream ifs(path);
-    if (!ifs)
-    {
-        std::cerr << "Cannot open " << path << std::endl;
-        return 2;
-    }
-    std::stringstream ss;
-    ss << ifs.rdbuf();
-    std::string src = ss.str();
-    return main_inner(src, pretty, outputFile);
-}
\ No newline at end of file
+    return main_inner(src->view(), opts, sp);
+}
@@ -0,0 +1,124 @@
+#include "node_stats.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+NodeStats::NodeStats(std::uint64_t sampleEvery) : sampleEvery(std::max<std::uint64_t>(sampleEvery, 1)) {}
+
+size_t NodeStats::kindOf(const Node *n)
+{
+    auto it = nodeKinds.find(n);
+    if (it != nodeKinds.end())
+        return it->second;
+
+    std::string name = kindName(n);
+    auto idIt = kindIds.find(name);
+    size_t id;
+    if (idIt == kindIds.end())
+    {
+        id = kinds.size();
+        kinds.push_back({name});
+        kindIds.emplace(name, id);
+    }
+    else
+    {
+        id = idIt->second;
+    }
+    nodeKinds.emplace(n, id);
+    return id;
+}
+
+std::string NodeStats::kindName(const Node *n)
+{
+    if (auto lit = dynamic_cast<const LiteralExpr *>(n))
+    {
+        switch (lit->kind)
+        {
+        case LiteralExpr::Kind::INTEGER:
+            return "LiteralExpr int";
+        case LiteralExpr::Kind::FLOAT:
+            return "LiteralExpr float";
+        case LiteralExpr::Kind::STRING:
+            return "LiteralExpr string";
+        default:
+            return "LiteralExpr bool";
+        }
+    }
+    if (dynamic_cast<const IdentExpr *>(n))
+        return "IdentExpr";
+    if (auto u = dynamic_cast<const UnaryExpr *>(n))
+        return "UnaryExpr " + u->op;
+    if (auto b = dynamic_cast<const BinaryExpr *>(n))
+        return "BinaryExpr " + b->op;
+    if (auto c = dynamic_cast<const CallExpr *>(n))
+    {
+        auto id = dynamic_cast<const IdentExpr *>(c->callee.get());
+        return id && isBuiltinFunction(id->name) ? "CallExpr builtin" : "CallExpr fn";
+    }
+    if (auto ix = dynamic_cast<const IndexExpr *>(n))
+        return ix->checked ? "IndexExpr checked" : "IndexExpr unchecked";
+    if (dynamic_cast<const ArrayExpr *>(n))
+        return "ArrayExpr";
+    if (dynamic_cast<const AccessExpr *>(n))
+        return "AccessExpr";
+
+    if (dynamic_cast<const ExprStmt *>(n))
+        return "ExprStmt";
+    if (dynamic_cast<const AssignStmt *>(n))
+        return "AssignStmt";
+    if (auto ds = dynamic_cast<const DeclStmt *>(n))
+    {
+        // 初始化方式: 表达式 / 初始化块 / 默认值
+        const char *init = ds->init.has_value() ? "init" : (!ds->initBlock.empty() ? "block" : "default");
+        return "DeclStmt " + ds->type + " " + init;
+    }
+    if (dynamic_cast<const IfStmt *>(n))
+        return "IfStmt";
+    if (auto fs = dynamic_cast<const ForStmt *>(n))
+        return fs->dims.empty() ? "ForStmt" : "ForStmt product";
+    if (auto os = dynamic_cast<const ObjStmt *>(n))
+        return os->proto.empty() ? "ObjStmt" : "ObjStmt proto";
+    if (dynamic_cast<const FnStmt *>(n))
+        return "FnStmt";
+    if (dynamic_cast<const ProtoStmt *>(n))
+        return "ProtoStmt";
+    if (dynamic_cast<const BreakStmt *>(n))
+        return "BreakStmt";
+    if (dynamic_cast<const ContinueStmt *>(n))
+        return "ContinueStmt";
+    return "Node";
+}
+
+std::string NodeStats::report() const
+{
+    double ticksPerMs = clock.ticksPerMs();
+
+    // 按样本平均值估算每个种类的总耗时
+    struct Row
+    {
+        const Kind *kind;
+        double estMs;
+    };
+    std::vector<Row> rows;
+    for (auto &k : kinds)
+    {
+        double avgTicks = k.samples ? static_cast<double>(k.sampledTicks) / static_cast<double>(k.samples) : 0.0;
+        rows.push_back({&k, avgTicks * static_cast<double>(k.count) / ticksPerMs});
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b)
+              { return a.estMs > b.estMs; });
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+    oss << "Node statistics (1 in " << sampleEvery << " executions timed, times include children)\n";
+    oss << std::setw(24) << "node kind" << std::setw(12) << "count" << std::setw(10) << "samples"
+        << std::setw(14) << "est. ms" << std::setw(12) << "avg ns" << "\n";
+    for (auto &row : rows)
+    {
+        const Kind &k = *row.kind;
+        oss << std::setw(24) << k.name << std::setw(12) << k.count << std::setw(10) << k.samples
+            << std::setw(14) << row.estMs << std::setw(12) << std::setprecision(1)
+            << (k.count ? row.estMs * 1e6 / static_cast<double>(k.count) : 0.0) << std::setprecision(3) << "\n";
+    }
+    return oss.str();
+}
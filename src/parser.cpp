@@ -1,9 +1,10 @@
 #include "parser.h"
+#include "alloc_stats.h"
 #include <algorithm>
 
-Parser::Parser(std::string src) : lex(std::move(src))
+Parser::Parser(std::string_view src, int firstLine) : tokens(Lexer(src, firstLine).tokenizeAll())
 {
-    cur = lex.nextToken();
+    cur = tokens[0];
 }
 
 Token Parser::peek()
@@ -11,10 +12,17 @@ Token Parser::peek()
     return cur;
 }
 
+Token Parser::peekNext()
+{
+    return tokens[pos + 1];
+}
+
 Token Parser::consume()
 {
     Token t = cur;
-    cur = lex.nextToken();
+    if (pos + 1 < tokens.size())
+        ++pos;
+    cur = tokens[pos];
     return t;
 }
 
@@ -45,6 +53,17 @@ void Parser::error(const std::string &msg)
     throw std::runtime_error(oss.str());
 }
 
+void Parser::Nesting::enter()
+{
+    ++levels;
+    if (++p.depth > MAX_NESTING_DEPTH)
+    {
+        std::ostringstream oss;
+        oss << "Parse error (line " << p.cur.line << "): Nesting too deep (more than " << MAX_NESTING_DEPTH << " levels)";
+        throw std::runtime_error(oss.str());
+    }
+}
+
 bool Parser::isExpressionStart()
 {
     return cur.kind == TokenKind::NUMBER ||
@@ -53,12 +72,14 @@ bool Parser::isExpressionStart()
            cur.kind == TokenKind::KW_TRUE ||
            cur.kind == TokenKind::KW_FALSE ||
            cur.kind == TokenKind::LPAREN ||
+           cur.kind == TokenKind::LBRACKET ||
            cur.kind == TokenKind::MINUS ||
            cur.kind == TokenKind::NOT;
 }
 
 std::unique_ptr<Program> Parser::parseProgram()
 {
+    ALLOC_PHASE(PARSE);
     auto prog = std::make_unique<Program>();
     while (cur.kind != TokenKind::END)
     {
@@ -67,15 +88,30 @@ std::unique_ptr<Program> Parser::parseProgram()
     return prog;
 }
 
+StmtPtr Parser::parseNextStmt()
+{
+    ALLOC_PHASE(PARSE);
+    if (cur.kind == TokenKind::END)
+        return nullptr;
+    return parseStmt();
+}
+
 StmtPtr Parser::parseStmt()
 {
+    Nesting nesting(*this);
+    nesting.enter();
     if (cur.kind == TokenKind::KW_IF)
         return parseIf();
     if (cur.kind == TokenKind::KW_FOR)
         return parseFor();
     if (cur.kind == TokenKind::KW_OBJ)
         return parseObj();
-    if (cur.kind == TokenKind::KW_NUM || cur.kind == TokenKind::KW_STR || cur.kind == TokenKind::KW_BOOL)
+    if (cur.kind == TokenKind::KW_FN)
+        return parseFn();
+    if (cur.kind == TokenKind::KW_PROTO)
+        return parseProto();
+    if (cur.kind == TokenKind::KW_NUM || cur.kind == TokenKind::KW_STR || cur.kind == TokenKind::KW_BOOL ||
+        cur.kind == TokenKind::KW_ARR)
         return parseDecl();
     if (cur.kind == TokenKind::KW_BREAK)
     {
@@ -95,16 +131,12 @@ StmtPtr Parser::parseStmt()
     // Check for assignment: IDENT = expr
     if (cur.kind == TokenKind::IDENT)
     {
-        // 需要前瞻来判断是否为赋值语句
-        // 创建临时词法分析器来检查下一个token
-        Lexer tempLex = lex; // 复制当前词法分析器状态
-        Token tempToken = tempLex.nextToken(); // 获取下一个token
-        
-        if (tempToken.kind == TokenKind::ASSIGN)
+        // 需要前瞻一个token来判断是否为赋值语句
+        if (peekNext().kind == TokenKind::ASSIGN)
         {
             // 这是赋值语句
             int line = cur.line;
-            std::string name = cur.text;
+            std::string name(cur.text);
             consume(); // consume IDENT
             expect(TokenKind::ASSIGN, "Expected '='");
             auto expr = parseExpr();
@@ -157,28 +189,46 @@ StmtPtr Parser::parseFor()
     expect(TokenKind::KW_FOR, "Expected 'for'");
     expect(TokenKind::LPAREN, "Expected '(' after 'for'");
     
-    if (cur.kind != TokenKind::IDENT)
-        error("Expected iterator variable name");
-    std::string iter = cur.text;
-    consume();
-    
-    expect(TokenKind::COMMA, "Expected ',' after iterator variable");
-    
-    auto forStmt = std::make_unique<ForStmt>(iter, line);
-    
-    // Parse arguments (1-3 expressions)
-    forStmt->args.push_back(parseExpr());
-    if (match(TokenKind::COMMA))
+    // Parse one dimension: iterator name and 1-3 range expressions
+    auto parseDim = [&](std::string &iter, std::vector<ExprPtr> &args)
     {
-        forStmt->args.push_back(parseExpr());
+        if (cur.kind != TokenKind::IDENT)
+            error("Expected iterator variable name");
+        iter = cur.text;
+        consume();
+        
+        expect(TokenKind::COMMA, "Expected ',' after iterator variable");
+        
+        args.push_back(parseExpr());
         if (match(TokenKind::COMMA))
         {
-            forStmt->args.push_back(parseExpr());
+            args.push_back(parseExpr());
+            if (match(TokenKind::COMMA))
+            {
+                args.push_back(parseExpr());
+            }
         }
+    };
+    
+    auto forStmt = std::make_unique<ForStmt>("", line);
+    parseDim(forStmt->iter, forStmt->args);
+    
+    // Product loop: for(a, 1, 4; b, 1, 13)
+    while (match(TokenKind::SEMI))
+    {
+        ForStmt::Dim dim;
+        parseDim(dim.iter, dim.args);
+        bool duplicate = dim.iter == forStmt->iter;
+        for (auto &other : forStmt->dims)
+            duplicate = duplicate || dim.iter == other.iter;
+        if (duplicate)
+            error("Duplicate iterator variable '" + dim.iter + "'");
+        forStmt->dims.push_back(std::move(dim));
     }
     
     expect(TokenKind::RPAREN, "Expected ')' after for arguments");
     forStmt->body = parseBlock();
+    markUncheckedIndexes(forStmt.get());
     
     return forStmt;
 }
@@ -191,7 +241,7 @@ StmtPtr Parser::parseObj()
     
     if (cur.kind != TokenKind::STRING)
         error("Expected class name string");
-    std::string className = cur.text;
+    std::string className(cur.text);
     consume();
     
     expect(TokenKind::COMMA, "Expected ',' after class name");
@@ -199,22 +249,90 @@ StmtPtr Parser::parseObj()
     expect(TokenKind::RPAREN, "Expected ')' after object id");
     
     auto objStmt = std::make_unique<ObjStmt>(className, std::move(idExpr), line);
+    objStmt->proto = parseProtoRef();
     objStmt->body = parseBlock();
     
     return objStmt;
 }
 
+StmtPtr Parser::parseProto()
+{
+    int line = cur.line;
+    expect(TokenKind::KW_PROTO, "Expected 'proto'");
+    expect(TokenKind::LPAREN, "Expected '(' after 'proto'");
+    
+    if (cur.kind != TokenKind::IDENT)
+        error("Expected prototype name");
+    std::string name(cur.text);
+    consume();
+    
+    expect(TokenKind::RPAREN, "Expected ')' after prototype name");
+    
+    auto protoStmt = std::make_unique<ProtoStmt>(name, line);
+    protoStmt->parent = parseProtoRef();
+    protoStmt->body = parseBlock();
+    
+    return protoStmt;
+}
+
+// Optional ": proto_name" before an object or prototype body
+std::string Parser::parseProtoRef()
+{
+    if (!match(TokenKind::COLON))
+        return "";
+    if (cur.kind != TokenKind::IDENT)
+        error("Expected prototype name after ':'");
+    std::string name(cur.text);
+    consume();
+    return name;
+}
+
+StmtPtr Parser::parseFn()
+{
+    int line = cur.line;
+    expect(TokenKind::KW_FN, "Expected 'fn'");
+    
+    if (cur.kind != TokenKind::IDENT)
+        error("Expected function name");
+    std::string name(cur.text);
+    consume();
+    
+    expect(TokenKind::LPAREN, "Expected '(' after function name");
+    
+    // Parse parameter names
+    std::vector<std::string> params;
+    if (cur.kind != TokenKind::RPAREN)
+    {
+        do
+        {
+            if (cur.kind != TokenKind::IDENT)
+                error("Expected parameter name");
+            if (std::find(params.begin(), params.end(), cur.text) != params.end())
+                error("Duplicate parameter name");
+            params.emplace_back(cur.text);
+            consume();
+        } while (match(TokenKind::COMMA));
+    }
+    
+    expect(TokenKind::RPAREN, "Expected ')' after parameters");
+    
+    auto fnStmt = std::make_unique<FnStmt>(name, std::move(params), line);
+    fnStmt->body = parseBlock();
+    
+    return fnStmt;
+}
+
 StmtPtr Parser::parseDecl()
 {
     int line = cur.line;
-    std::string type = cur.text;
+    std::string type(cur.text);
     consume(); // consume type keyword
     
     expect(TokenKind::LPAREN, "Expected '(' after type");
     
     if (cur.kind != TokenKind::IDENT)
         error("Expected variable name");
-    std::string name = cur.text;
+    std::string name(cur.text);
     consume();
     
     expect(TokenKind::RPAREN, "Expected ')' after variable name");
@@ -283,4 +401,82 @@ std::vector<StmtPtr> Parser::parseBlock()
     
     expect(TokenKind::RBRACE, "Expected '}'");
     return stmts;
+}
+
+// for(i, 0, len(a) - 1) 形式的循环: 若循环体不修改 a 和 i, 也不调用用户函数,
+// 则循环体内的 a[i] 一定在范围内, 可以跳过越界检查
+void markUncheckedIndexes(ForStmt *fs)
+{
+    if (fs->args.size() != 2 || !fs->dims.empty())
+        return;
+    
+    auto start = dynamic_cast<LiteralExpr *>(fs->args[0].get());
+    if (!start || start->kind != LiteralExpr::Kind::INTEGER || start->ival < 0)
+        return;
+    
+    auto bound = dynamic_cast<BinaryExpr *>(fs->args[1].get());
+    if (!bound || bound->op != "-")
+        return;
+    auto one = dynamic_cast<LiteralExpr *>(bound->rhs.get());
+    if (!one || one->kind != LiteralExpr::Kind::INTEGER || one->ival != 1)
+        return;
+    auto call = dynamic_cast<CallExpr *>(bound->lhs.get());
+    if (!call || call->args.size() != 1)
+        return;
+    auto callee = dynamic_cast<IdentExpr *>(call->callee.get());
+    auto target = dynamic_cast<IdentExpr *>(call->args[0].get());
+    if (!callee || callee->name != "len" || !target || target->name == fs->iter)
+        return;
+    
+    const std::string &array = target->name;
+    const std::string &iter = fs->iter;
+    auto rebinds = [&](const std::string &name) { return name == array || name == iter; };
+    
+    bool safe = true;
+    std::vector<IndexExpr *> candidates;
+    std::function<void(Node *)> visit = [&](Node *n)
+    {
+        if (auto as = dynamic_cast<AssignStmt *>(n))
+        {
+            if (rebinds(as->name))
+                safe = false;
+        }
+        else if (auto ds = dynamic_cast<DeclStmt *>(n))
+        {
+            if (rebinds(ds->name))
+                safe = false;
+        }
+        else if (auto inner = dynamic_cast<ForStmt *>(n))
+        {
+            if (rebinds(inner->iter))
+                safe = false;
+        }
+        else if (dynamic_cast<FnStmt *>(n))
+        {
+            safe = false;
+        }
+        else if (auto c = dynamic_cast<CallExpr *>(n))
+        {
+            // 用户函数可以修改调用方的变量
+            auto id = dynamic_cast<IdentExpr *>(c->callee.get());
+            if (!id || !isBuiltinFunction(id->name))
+                safe = false;
+        }
+        else if (auto ix = dynamic_cast<IndexExpr *>(n))
+        {
+            auto t = dynamic_cast<IdentExpr *>(ix->target.get());
+            auto i = dynamic_cast<IdentExpr *>(ix->index.get());
+            if (t && i && t->name == array && i->name == iter)
+                candidates.push_back(ix);
+        }
+        forEachChild(n, visit);
+    };
+    for (auto &st : fs->body)
+        visit(st.get());
+    
+    if (safe)
+    {
+        for (auto ix : candidates)
+            ix->checked = false;
+    }
 }
\ No newline at end of file
@@ -7,12 +7,14 @@ ExprPtr Parser::parseExpr()
 
 ExprPtr Parser::parseLogicalOr()
 {
+    Nesting nesting(*this);
     auto left = parseLogicalAnd();
     
     while (cur.kind == TokenKind::OR)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
+        nesting.enter();
         consume();
         auto right = parseLogicalAnd();
         left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
@@ -23,12 +25,14 @@ ExprPtr Parser::parseLogicalOr()
 
 ExprPtr Parser::parseLogicalAnd()
 {
+    Nesting nesting(*this);
     auto left = parseEquality();
     
     while (cur.kind == TokenKind::AND)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
+        nesting.enter();
         consume();
         auto right = parseEquality();
         left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
@@ -39,12 +43,14 @@ ExprPtr Parser::parseLogicalAnd()
 
 ExprPtr Parser::parseEquality()
 {
+    Nesting nesting(*this);
     auto left = parseComparison();
     
     while (cur.kind == TokenKind::EQ || cur.kind == TokenKind::NEQ)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
+        nesting.enter();
         consume();
         auto right = parseComparison();
         left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
@@ -55,13 +61,15 @@ ExprPtr Parser::parseEquality()
 
 ExprPtr Parser::parseComparison()
 {
+    Nesting nesting(*this);
     auto left = parseAddition();
     
     while (cur.kind == TokenKind::LT || cur.kind == TokenKind::GT || 
            cur.kind == TokenKind::LE || cur.kind == TokenKind::GE)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
+        nesting.enter();
         consume();
         auto right = parseAddition();
         left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
@@ -72,12 +80,14 @@ ExprPtr Parser::parseComparison()
 
 ExprPtr Parser::parseAddition()
 {
+    Nesting nesting(*this);
     auto left = parseMultiplication();
     
     while (cur.kind == TokenKind::PLUS || cur.kind == TokenKind::MINUS)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
+        nesting.enter();
         consume();
         auto right = parseMultiplication();
         left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
@@ -88,12 +98,14 @@ ExprPtr Parser::parseAddition()
 
 ExprPtr Parser::parseMultiplication()
 {
+    Nesting nesting(*this);
     auto left = parseUnary();
     
     while (cur.kind == TokenKind::MUL || cur.kind == TokenKind::DIV || cur.kind == TokenKind::MOD)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
+        nesting.enter();
         consume();
         auto right = parseUnary();
         left = std::make_unique<BinaryExpr>(std::move(left), op, std::move(right), line);
@@ -104,9 +116,11 @@ ExprPtr Parser::parseMultiplication()
 
 ExprPtr Parser::parseUnary()
 {
+    Nesting nesting(*this);
+    nesting.enter();
     if (cur.kind == TokenKind::NOT || cur.kind == TokenKind::MINUS)
     {
-        std::string op = cur.text;
+        std::string op(cur.text);
         int line = cur.line;
         consume();
         auto right = parseUnary();
@@ -123,7 +137,7 @@ ExprPtr Parser::parsePrimary()
     // Numbers (integers and floating point)
     if (cur.kind == TokenKind::NUMBER)
     {
-        std::string text = cur.text;
+        std::string text(cur.text);
         consume();
         
         ExprPtr expr;
@@ -145,7 +159,7 @@ ExprPtr Parser::parsePrimary()
     // Strings
     if (cur.kind == TokenKind::STRING)
     {
-        std::string value = cur.text;
+        std::string value(cur.text);
         consume();
         auto expr = std::make_unique<LiteralExpr>(value, line);
         return parseCall(std::move(expr));
@@ -169,12 +183,18 @@ ExprPtr Parser::parsePrimary()
     // Identifiers
     if (cur.kind == TokenKind::IDENT)
     {
-        std::string name = cur.text;
+        std::string name(cur.text);
         consume();
         auto expr = std::make_unique<IdentExpr>(name, line);
         return parseCall(std::move(expr));
     }
     
+    // Array literals
+    if (cur.kind == TokenKind::LBRACKET)
+    {
+        return parseCall(parseArray());
+    }
+    
     // Parenthesized expressions
     if (cur.kind == TokenKind::LPAREN)
     {
@@ -189,8 +209,11 @@ ExprPtr Parser::parsePrimary()
 
 ExprPtr Parser::parseCall(ExprPtr callee)
 {
+    Nesting nesting(*this);
     while (true)
     {
+        if (cur.kind == TokenKind::LPAREN || cur.kind == TokenKind::LBRACKET || cur.kind == TokenKind::DOT)
+            nesting.enter();
         if (cur.kind == TokenKind::LPAREN)
         {
             // Function call
@@ -210,6 +233,15 @@ ExprPtr Parser::parseCall(ExprPtr callee)
             expect(TokenKind::RPAREN, "Expected ')' after arguments");
             callee = std::make_unique<CallExpr>(std::move(callee), std::move(args), line);
         }
+        else if (cur.kind == TokenKind::LBRACKET)
+        {
+            // Indexing
+            int line = cur.line;
+            consume(); // consume '['
+            auto index = parseExpr();
+            expect(TokenKind::RBRACKET, "Expected ']' after index");
+            callee = std::make_unique<IndexExpr>(std::move(callee), std::move(index), line);
+        }
         else if (cur.kind == TokenKind::DOT)
         {
             // Member access
@@ -219,7 +251,7 @@ ExprPtr Parser::parseCall(ExprPtr callee)
             if (cur.kind != TokenKind::IDENT)
                 error("Expected member name after '.'");
             
-            std::string member = cur.text;
+            std::string member(cur.text);
             consume();
             
             callee = std::make_unique<AccessExpr>(std::move(callee), member, line);
@@ -231,4 +263,23 @@ ExprPtr Parser::parseCall(ExprPtr callee)
     }
     
     return callee;
+}
+
+ExprPtr Parser::parseArray()
+{
+    int line = cur.line;
+    expect(TokenKind::LBRACKET, "Expected '['");
+    
+    std::vector<ExprPtr> elems;
+    if (cur.kind != TokenKind::RBRACKET)
+    {
+        elems.push_back(parseExpr());
+        while (match(TokenKind::COMMA))
+        {
+            elems.push_back(parseExpr());
+        }
+    }
+    
+    expect(TokenKind::RBRACKET, "Expected ']' after array elements");
+    return std::make_unique<ArrayExpr>(std::move(elems), line);
 }
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "parser.h"
+#include "lexer_scan.h"
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+namespace
+{
+    // 小脚本的解析耗时不足以抵消线程开销
+    constexpr size_t PARALLEL_PARSE_MIN_BYTES = 1 << 20;
+    constexpr size_t PARALLEL_PARSE_MIN_CHUNK = 256 << 10;
+
+    // 顶层语句的起点: 源代码偏移和该处的行号
+    struct Boundary
+    {
+        size_t offset;
+        int line;
+    };
+
+    bool isBlankChar(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    bool isIdentChar(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    // 跳过空白和注释后的下一个单词是否为 elif/else, 是则 if 语句尚未结束
+    bool continuesIf(std::string_view src, size_t i)
+    {
+        size_t n = src.size();
+        while (i < n)
+        {
+            if (isBlankChar(src[i]))
+                ++i;
+            else if (src[i] == '/' && i + 1 < n && src[i + 1] == '/')
+                i = scanNewline(src.data(), i + 2, n);
+            else
+                break;
+        }
+        for (std::string_view kw : {std::string_view("elif"), std::string_view("else")})
+            if (src.substr(i, kw.size()) == kw && (i + kw.size() >= n || !isIdentChar(src[i + kw.size()])))
+                return true;
+        return false;
+    }
+
+    // Top-level statement boundaries 顶层语句边界
+    // 深度回到 0 的 '}' 之后就是新语句的起点(if 后接 elif/else 除外).
+    // 行号只统计字符串之外的换行, 与 Lexer 一致. 括号不平衡、字符串未结束或包含 '\0' 时返回空,
+    // 由调用方顺序解析并报告错误
+    std::vector<Boundary> findBoundaries(std::string_view src)
+    {
+        std::vector<Boundary> result;
+        size_t n = src.size();
+        size_t i = 0;
+        int line = 1;
+        int depth = 0;
+        while (i < n)
+        {
+            char c = src[i];
+            switch (c)
+            {
+            case '\n':
+                ++line;
+                ++i;
+                break;
+            case '/':
+                i = i + 1 < n && src[i + 1] == '/' ? scanNewline(src.data(), i + 2, n) : i + 1;
+                break;
+            case '"':
+                for (++i; i < n && src[i] != '"'; ++i)
+                {
+                    if (src[i] == '\0')
+                        return {};
+                    if (src[i] == '\\')
+                        ++i;
+                }
+                if (i >= n)
+                    return {};
+                ++i;
+                break;
+            case '{':
+            case '(':
+            case '[':
+                ++depth;
+                ++i;
+                break;
+            case '}':
+            case ')':
+            case ']':
+                if (--depth < 0)
+                    return {};
+                ++i;
+                if (c == '}' && depth == 0 && !continuesIf(src, i))
+                    result.push_back({i, line});
+                break;
+            case '\0':
+                return {};
+            default:
+                ++i;
+                break;
+            }
+        }
+        if (depth != 0)
+            return {};
+        return result;
+    }
+
+    std::unique_ptr<Program> parseSequential(std::string_view src)
+    {
+        Parser parser(src);
+        return parser.parseProgram();
+    }
+}
+
+std::unique_ptr<Program> parseProgram(std::string_view src, unsigned threads)
+{
+    size_t workers = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, src.size() / PARALLEL_PARSE_MIN_CHUNK);
+    if (workers < 2 || src.size() < PARALLEL_PARSE_MIN_BYTES)
+        return parseSequential(src);
+
+    std::vector<Boundary> boundaries = findBoundaries(src);
+
+    // 按字节数大致均分, 每个片段从一个语句边界开始
+    std::vector<Boundary> starts = {{0, 1}};
+    size_t target = src.size() / workers;
+    for (auto &b : boundaries)
+    {
+        if (b.offset >= src.size())
+            break;
+        if (b.offset >= starts.size() * target)
+        {
+            starts.push_back(b);
+            if (starts.size() == workers)
+                break;
+        }
+    }
+    if (starts.size() < 2)
+        return parseSequential(src);
+
+    size_t chunks = starts.size();
+    std::vector<std::unique_ptr<Program>> parts(chunks);
+    std::vector<std::exception_ptr> errors(chunks);
+    std::vector<std::thread> pool;
+    for (size_t c = 0; c < chunks; ++c)
+    {
+        pool.emplace_back([&, c]()
+                          {
+            size_t begin = starts[c].offset;
+            size_t end = c + 1 < chunks ? starts[c + 1].offset : src.size();
+            try
+            {
+                Parser parser(src.substr(begin, end - begin), starts[c].line);
+                parts[c] = parser.parseProgram();
+            }
+            catch (...)
+            {
+                errors[c] = std::current_exception();
+            } });
+    }
+    for (auto &t : pool)
+        t.join();
+
+    for (auto &error : errors)
+        if (error)
+            return parseSequential(src);
+
+    auto program = std::move(parts[0]);
+    for (size_t c = 1; c < chunks; ++c)
+        for (auto &stmt : parts[c]->stmts)
+            program->stmts.push_back(std::move(stmt));
+    return program;
+}
@@ -0,0 +1,196 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define LUDUS_HAS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define LUDUS_HAS_TSC 1
+#endif
+
+namespace
+{
+    std::uint64_t steadyNanos()
+    {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now().time_since_epoch())
+                                              .count());
+    }
+
+    // Trimmed source text of each line, indexed from 1
+    std::vector<std::string> sourceLines(std::string_view source)
+    {
+        std::vector<std::string> result(1);
+        std::istringstream iss{std::string(source)};
+        std::string text;
+        while (std::getline(iss, text))
+        {
+            size_t first = text.find_first_not_of(" \t");
+            size_t last = text.find_last_not_of(" \t\r");
+            result.push_back(first == std::string::npos ? "" : text.substr(first, last - first + 1));
+        }
+        return result;
+    }
+
+    const std::string &lineText(const std::vector<std::string> &text, size_t line)
+    {
+        static const std::string empty;
+        return line < text.size() ? text[line] : empty;
+    }
+}
+
+std::uint64_t profileTicks()
+{
+#ifdef LUDUS_HAS_TSC
+    return __rdtsc();
+#else
+    return steadyNanos();
+#endif
+}
+
+TickClock::TickClock() : start(profileTicks()), startNanos(steadyNanos()) {}
+
+double TickClock::ticksPerMs() const
+{
+    std::uint64_t ticks = profileTicks() - start;
+    std::uint64_t nanos = steadyNanos() - startNanos;
+    if (nanos == 0 || ticks == 0)
+        return 1e6;
+    return static_cast<double>(ticks) / (static_cast<double>(nanos) / 1e6);
+}
+
+Profiler::Profiler() {}
+
+void Profiler::enter(int line, const std::string *objClass)
+{
+    if (line >= static_cast<int>(lines.size()))
+    {
+        lines.resize(line + 1);
+        activeLines.resize(line + 1);
+    }
+    ++activeLines[line];
+    if (objClass)
+        ++activeClasses[*objClass];
+    stack.push_back({line, objClass, profileTicks(), 0});
+}
+
+void Profiler::exit()
+{
+    std::uint64_t now = profileTicks();
+    Frame f = stack.back();
+    stack.pop_back();
+
+    std::uint64_t elapsed = now - f.start;
+    std::uint64_t self = elapsed > f.children ? elapsed - f.children : 0;
+    if (!stack.empty())
+        stack.back().children += elapsed;
+
+    Stat &st = lines[f.line];
+    ++st.count;
+    st.exclusive += self;
+    if (--activeLines[f.line] == 0)
+        st.inclusive += elapsed;
+
+    if (f.objClass)
+    {
+        Stat &cs = classes[*f.objClass];
+        ++cs.count;
+        cs.exclusive += self;
+        if (--activeClasses[*f.objClass] == 0)
+            cs.inclusive += elapsed;
+    }
+}
+
+void Profiler::finish()
+{
+    totalTicks = profileTicks() - clock.startTicks();
+    ticksPerMs = clock.ticksPerMs();
+}
+
+double Profiler::ms(std::uint64_t ticks) const
+{
+    return static_cast<double>(ticks) / ticksPerMs;
+}
+
+std::string Profiler::report(std::string_view source, size_t top) const
+{
+    std::vector<int> order;
+    for (size_t line = 0; line < lines.size(); ++line)
+        if (lines[line].count > 0)
+            order.push_back(static_cast<int>(line));
+    std::sort(order.begin(), order.end(), [&](int a, int b)
+              { return lines[a].exclusive > lines[b].exclusive; });
+    if (order.size() > top)
+        order.resize(top);
+
+    auto text = sourceLines(source);
+    double total = ms(totalTicks);
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+    oss << "Profile: " << total << " ms total, hot lines by exclusive time\n";
+    oss << std::setw(6) << "line" << std::setw(12) << "count" << std::setw(14) << "incl ms"
+        << std::setw(14) << "excl ms" << std::setw(8) << "excl%" << "  source\n";
+    for (int line : order)
+    {
+        const Stat &st = lines[line];
+        double excl = ms(st.exclusive);
+        oss << std::setw(6) << line << std::setw(12) << st.count << std::setw(14) << ms(st.inclusive)
+            << std::setw(14) << excl << std::setw(7) << std::setprecision(1)
+            << (total > 0 ? excl * 100.0 / total : 0.0) << "%" << std::setprecision(3)
+            << "  " << lineText(text, line) << "\n";
+    }
+
+    if (!classes.empty())
+    {
+        std::vector<std::pair<std::string, Stat>> sorted(classes.begin(), classes.end());
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+                  { return a.second.inclusive > b.second.inclusive; });
+        oss << "Object classes by inclusive time\n";
+        oss << std::setw(20) << "class" << std::setw(12) << "count" << std::setw(14) << "incl ms"
+            << std::setw(14) << "excl ms" << std::setw(14) << "us/object\n";
+        for (auto &entry : sorted)
+        {
+            const Stat &st = entry.second;
+            oss << std::setw(20) << entry.first << std::setw(12) << st.count << std::setw(14) << ms(st.inclusive)
+                << std::setw(14) << ms(st.exclusive) << std::setw(13)
+                << ms(st.inclusive) * 1000.0 / static_cast<double>(st.count) << "\n";
+        }
+    }
+    return oss.str();
+}
+
+json Profiler::toJson(std::string_view source) const
+{
+    auto text = sourceLines(source);
+    json j;
+    j["total_ms"] = ms(totalTicks);
+
+    json lineArr = json::array();
+    for (size_t line = 0; line < lines.size(); ++line)
+    {
+        const Stat &st = lines[line];
+        if (st.count == 0)
+            continue;
+        lineArr.push_back({{"line", line},
+                           {"count", st.count},
+                           {"inclusive_ms", ms(st.inclusive)},
+                           {"exclusive_ms", ms(st.exclusive)},
+                           {"source", lineText(text, line)}});
+    }
+    j["lines"] = lineArr;
+
+    json classArr = json::array();
+    for (auto &entry : classes)
+    {
+        classArr.push_back({{"class", entry.first},
+                            {"count", entry.second.count},
+                            {"inclusive_ms", ms(entry.second.inclusive)},
+                            {"exclusive_ms", ms(entry.second.exclusive)}});
+    }
+    j["classes"] = classArr;
+    return j;
+}
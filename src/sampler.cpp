@@ -0,0 +1,157 @@
+#include "sampler.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/time.h>
+#define LUDUS_HAS_SIGPROF 1
+#endif
+
+namespace
+{
+    // 当前接收信号的采样器, 信号处理函数中只能访问无锁原子变量
+    std::atomic<Sampler *> activeSampler{nullptr};
+
+#ifdef LUDUS_HAS_SIGPROF
+    struct sigaction previousAction;
+#endif
+}
+
+Sampler::Sampler(ScriptStack &stack, size_t capacity) : stack(stack), samples(std::max<size_t>(capacity, 1)) {}
+
+Sampler::~Sampler()
+{
+    stop();
+}
+
+bool Sampler::supported()
+{
+#ifdef LUDUS_HAS_SIGPROF
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Sampler::start(int hz)
+{
+#ifdef LUDUS_HAS_SIGPROF
+    if (hz < 1 || hz > 100000)
+        throw std::runtime_error("Sampling frequency must be between 1 and 100000 Hz");
+    Sampler *expected = nullptr;
+    if (!activeSampler.compare_exchange_strong(expected, this))
+        throw std::runtime_error("Another sampler is already running");
+
+    struct sigaction action = {};
+    action.sa_handler = &Sampler::onSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGPROF, &action, &previousAction);
+
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = 1000000 / hz;
+    if (timer.it_interval.tv_usec == 0)
+        timer.it_interval.tv_usec = 1;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    running = true;
+#else
+    (void)hz;
+    throw std::runtime_error("Sampling profiler requires SIGPROF and is only available on POSIX systems");
+#endif
+}
+
+void Sampler::stop()
+{
+#ifdef LUDUS_HAS_SIGPROF
+    if (!running)
+        return;
+    struct itimerval timer = {};
+    setitimer(ITIMER_PROF, &timer, nullptr);
+    sigaction(SIGPROF, &previousAction, nullptr);
+    activeSampler.store(nullptr);
+    running = false;
+#endif
+}
+
+void Sampler::onSignal(int)
+{
+    if (Sampler *s = activeSampler.load(std::memory_order_relaxed))
+        s->takeSample();
+}
+
+// 在信号处理函数中执行: 不分配内存, 只复制栈中的节点指针
+void Sampler::takeSample()
+{
+    size_t idx = count.load(std::memory_order_relaxed);
+    if (idx >= samples.size())
+    {
+        droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    int depth = stack.depth.load(std::memory_order_relaxed);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    Sample &sample = samples[idx];
+    sample.depth = std::min(std::max(depth, 0), ScriptStack::MAX_DEPTH);
+    for (int i = 0; i < sample.depth; ++i)
+        sample.frames[i] = stack.frames[i];
+    count.store(idx + 1, std::memory_order_relaxed);
+}
+
+size_t Sampler::sampleCount() const
+{
+    return std::min(count.load(), samples.size());
+}
+
+std::string Sampler::frameName(const Node *n)
+{
+    std::string name;
+    if (auto fs = dynamic_cast<const ForStmt *>(n))
+    {
+        name = "for(" + fs->iter;
+        for (auto &dim : fs->dims)
+            name += ", " + dim.iter;
+        name += ")";
+    }
+    else if (auto os = dynamic_cast<const ObjStmt *>(n))
+        name = "obj " + os->className;
+    else if (auto ds = dynamic_cast<const DeclStmt *>(n))
+        name = ds->type + "(" + ds->name + ")";
+    else if (dynamic_cast<const IfStmt *>(n))
+        name = "if";
+    else if (auto fn = dynamic_cast<const FnStmt *>(n))
+        return "fn " + fn->name; // 同一函数的所有调用合并
+    else if (auto as = dynamic_cast<const AssignStmt *>(n))
+        name = as->name + " =";
+    else if (auto ps = dynamic_cast<const ProtoStmt *>(n))
+        name = "proto " + ps->name;
+    else if (dynamic_cast<const BreakStmt *>(n))
+        name = "break";
+    else if (dynamic_cast<const ContinueStmt *>(n))
+        name = "continue";
+    else
+        name = "expr";
+    name += " L" + std::to_string(n->line);
+
+    // ';' 是折叠栈格式的分隔符
+    std::replace(name.begin(), name.end(), ';', ',');
+    return name;
+}
+
+void Sampler::writeFolded(std::ostream &os, const std::string &root) const
+{
+    std::map<std::string, size_t> folded;
+    for (size_t i = 0; i < sampleCount(); ++i)
+    {
+        const Sample &sample = samples[i];
+        std::string key = root;
+        for (int d = 0; d < sample.depth; ++d)
+            key += ";" + frameName(sample.frames[d]);
+        ++folded[key];
+    }
+    for (auto &entry : folded)
+        os << entry.first << " " << entry.second << "\n";
+}
@@ -0,0 +1,709 @@
+#include "server.h"
+#include "ast_cache.h"
+#include "interpreter.h"
+#include "parser.h"
+#include "source_file.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define LUDUS_HAS_UNIX_SOCKET 1
+#endif
+
+namespace
+{
+    // 单个请求行的上限, 防止客户端不发送换行时无限占用内存
+    constexpr size_t MAX_REQUEST_BYTES = 64 << 20;
+    // poll 线程检查停止标志的间隔
+    constexpr int ACCEPT_POLL_MS = 200;
+    // 客户端不读取响应时写入最多阻塞的时间, 超时后断开连接, 工作线程不会被一直占用
+    constexpr int SEND_TIMEOUT_S = 30;
+    // 多进程模式下补充崩溃的工作进程前等待, 连续崩溃时等待时间逐次加倍.
+    // CRASH_WINDOW_S 秒内崩溃超过 MAX_CRASHES 次视为无法恢复(例如每个请求都触发的缺陷), 服务以错误退出
+    constexpr int RESPAWN_DELAY_MS = 100;
+    constexpr int MAX_RESPAWN_DELAY_MS = 5000;
+    constexpr int CRASH_WINDOW_S = 60;
+    constexpr size_t MAX_CRASHES = 10;
+
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        size_t rank = static_cast<size_t>(p / 100.0 * static_cast<double>(sorted.size()) + 0.999999);
+        rank = std::min(std::max<size_t>(rank, 1), sorted.size());
+        return sorted[rank - 1];
+    }
+
+    std::string errorResponse(const std::string &message)
+    {
+        // 错误信息可能包含文件名等非 UTF-8 文本
+        return json{{"ok", false}, {"error", message}}.dump(-1, ' ', false, json::error_handler_t::replace) + "\n";
+    }
+
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    // 多进程模式下父进程收到 SIGTERM/SIGINT
+    volatile std::sig_atomic_t terminateRequested = 0;
+
+    void onTerminate(int)
+    {
+        terminateRequested = 1;
+    }
+
+    bool sendAll(int fd, std::string_view data)
+    {
+        while (!data.empty())
+        {
+            ssize_t n = ::write(fd, data.data(), data.size());
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            data.remove_prefix(static_cast<size_t>(n));
+        }
+        return true;
+    }
+
+    void setNonBlocking(int fd, bool nonBlocking)
+    {
+        int flags = ::fcntl(fd, F_GETFL, 0);
+        if (flags >= 0)
+            ::fcntl(fd, F_SETFL, nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+    }
+#endif
+}
+
+ProgramCache::ProgramCache(size_t capacity) : capacity(capacity) {}
+
+std::shared_ptr<const CompiledScript> ProgramCache::get(std::string_view source)
+{
+    std::uint64_t key = fnv1a64(source);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end() || it->second->source != source)
+        return nullptr;
+    entries.splice(entries.begin(), entries, it->second);
+    return it->second->script;
+}
+
+void ProgramCache::put(std::string_view source, std::shared_ptr<const CompiledScript> script)
+{
+    if (capacity == 0)
+        return;
+    std::uint64_t key = fnv1a64(source);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end())
+    {
+        it->second->source = std::string(source);
+        it->second->script = std::move(script);
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+    entries.push_front({key, std::string(source), std::move(script)});
+    index[key] = entries.begin();
+    while (entries.size() > capacity)
+    {
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+size_t ProgramCache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+LatencyStats::LatencyStats(size_t window) : window(std::max<size_t>(window, 1)) {}
+
+void LatencyStats::record(double ms, bool ok, bool cacheHit)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ++requests;
+    if (!ok)
+        ++errors;
+    else if (cacheHit)
+        ++cacheHits;
+    else
+        ++cacheMisses;
+
+    if (samples.size() < window)
+        samples.push_back(ms);
+    else
+        samples[next] = ms;
+    next = (next + 1) % window;
+}
+
+json LatencyStats::toJson() const
+{
+    std::vector<double> sorted;
+    json j;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sorted = samples;
+        j = {{"requests", requests}, {"errors", errors}, {"cache_hits", cacheHits}, {"cache_misses", cacheMisses}};
+    }
+    std::sort(sorted.begin(), sorted.end());
+    json latency = {{"window", sorted.size()}};
+    if (!sorted.empty())
+    {
+        latency["p50_ms"] = percentile(sorted, 50);
+        latency["p90_ms"] = percentile(sorted, 90);
+        latency["p99_ms"] = percentile(sorted, 99);
+        latency["max_ms"] = sorted.back();
+    }
+    j["latency"] = std::move(latency);
+    return j;
+}
+
+Server::Server(Options o) : opts(std::move(o)), cache(opts.cacheCapacity) {}
+
+Server::~Server()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    if (listenFd >= 0)
+        ::close(listenFd);
+#endif
+}
+
+bool Server::supported()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Server::run()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    // 客户端提前断开时 write 返回错误, 而不是终止进程
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (opts.socketPath.empty() || opts.socketPath.size() >= sizeof(addr.sun_path))
+        throw std::runtime_error("Invalid socket path '" + opts.socketPath + "'");
+    opts.socketPath.copy(addr.sun_path, opts.socketPath.size());
+
+    for (auto &path : opts.preload)
+    {
+        try
+        {
+            SourceFile file(path);
+            cache.put(file.view(), compile(file.view()));
+        }
+        catch (const std::exception &ex)
+        {
+            throw std::runtime_error("Cannot preload " + path + ": " + ex.what());
+        }
+    }
+
+    // 上次运行遗留的套接字文件无人监听时删除; 仍有服务在监听或路径不是套接字时报错
+    struct stat st;
+    if (::lstat(opts.socketPath.c_str(), &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+            throw std::runtime_error(opts.socketPath + " exists and is not a socket");
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && ::connect(probe, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0)
+            ::close(probe);
+        if (live)
+            throw std::runtime_error("Another server is already listening on " + opts.socketPath);
+        ::unlink(opts.socketPath.c_str());
+    }
+
+    listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listenFd, SOMAXCONN) != 0)
+        throw std::runtime_error("Cannot listen on " + opts.socketPath);
+
+    if (opts.prefork)
+    {
+        bool healthy = runPrefork();
+        ::close(listenFd);
+        listenFd = -1;
+        ::unlink(opts.socketPath.c_str());
+        if (!healthy)
+            throw std::runtime_error("Worker processes crashed more than " + std::to_string(MAX_CRASHES) + " times within " +
+                                     std::to_string(CRASH_WINDOW_S) + " seconds, giving up");
+        return;
+    }
+
+    openWakePipe();
+    unsigned workers = opts.workers ? opts.workers : std::max(1u, std::thread::hardware_concurrency());
+    std::vector<std::thread> pool;
+    for (unsigned i = 0; i < workers; ++i)
+        pool.emplace_back([this]()
+                          { workerLoop(); });
+
+    eventLoop(false);
+
+    for (auto &t : pool)
+        t.join();
+    closeConnections();
+    ::close(listenFd);
+    listenFd = -1;
+    ::unlink(opts.socketPath.c_str());
+#else
+    throw std::runtime_error("--serve requires Unix domain sockets and is only available on POSIX systems");
+#endif
+}
+
+// 父进程此时只有一个线程, fork 是安全的; 工作进程只运行 childLoop, 从不返回到调用方
+bool Server::runPrefork()
+{
+    bool healthy = true;
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    // 不设置 SA_RESTART, 使 waitpid 被信号打断
+    struct sigaction action = {};
+    action.sa_handler = &onTerminate;
+    sigemptyset(&action.sa_mask);
+    struct sigaction previousTerm, previousInt;
+    sigaction(SIGTERM, &action, &previousTerm);
+    sigaction(SIGINT, &action, &previousInt);
+    terminateRequested = 0;
+
+    std::unordered_set<pid_t> children;
+    auto spawn = [&]()
+    {
+        pid_t pid = ::fork();
+        if (pid == 0)
+        {
+            sigaction(SIGTERM, &previousTerm, nullptr);
+            sigaction(SIGINT, &previousInt, nullptr);
+            try
+            {
+                childLoop();
+            }
+            catch (...)
+            {
+                ::_exit(1);
+            }
+            ::_exit(0);
+        }
+        if (pid < 0)
+            std::cerr << "Warning: cannot fork worker process" << std::endl;
+        else
+            children.insert(pid);
+    };
+    for (unsigned i = 0; i < opts.prefork; ++i)
+        spawn();
+
+    // 工作进程只在处理 shutdown 请求后正常退出, 其他退出视为崩溃, 等待一段时间后补充新的工作进程
+    std::deque<std::chrono::steady_clock::time_point> crashes;
+    while (!terminateRequested && !children.empty())
+    {
+        int status = 0;
+        pid_t pid = ::waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        children.erase(pid);
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+            break;
+
+        auto now = std::chrono::steady_clock::now();
+        crashes.push_back(now);
+        while (now - crashes.front() > std::chrono::seconds(CRASH_WINDOW_S))
+            crashes.pop_front();
+        if (crashes.size() > MAX_CRASHES)
+        {
+            std::cerr << "Worker " << pid << " exited unexpectedly, not restarting" << std::endl;
+            healthy = false;
+            break;
+        }
+        int delay = RESPAWN_DELAY_MS << std::min<size_t>(crashes.size() - 1, 6);
+        delay = std::min(delay, MAX_RESPAWN_DELAY_MS);
+        std::cerr << "Worker " << pid << " exited unexpectedly, restarting in " << delay << " ms" << std::endl;
+        // 等待期间收到 SIGTERM/SIGINT 时 poll 被打断, 不再补充
+        ::poll(nullptr, 0, delay);
+        if (!terminateRequested)
+            spawn();
+    }
+
+    for (pid_t pid : children)
+        ::kill(pid, SIGTERM);
+    for (pid_t pid : children)
+        ::waitpid(pid, nullptr, 0);
+    sigaction(SIGTERM, &previousTerm, nullptr);
+    sigaction(SIGINT, &previousInt, nullptr);
+#endif
+    return healthy;
+}
+
+void Server::childLoop()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    openWakePipe();
+    eventLoop(true);
+    closeConnections();
+#endif
+}
+
+void Server::eventLoop(bool inlineRequests)
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    // 多进程模式下所有工作进程都监视同一个监听套接字, 没有抢到连接的进程 accept 不能阻塞
+    setNonBlocking(listenFd, true);
+
+    std::vector<pollfd> fds;
+    while (!stopping)
+    {
+        fds.clear();
+        fds.push_back({listenFd, POLLIN, 0});
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        size_t backlog; // 单线程模式下等待本线程处理的连接数, 非零时 poll 不等待
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (int fd : idle)
+                fds.push_back({fd, POLLIN, 0});
+            backlog = inlineRequests ? ready.size() : 0;
+        }
+        if (::poll(fds.data(), fds.size(), backlog ? 0 : ACCEPT_POLL_MS) < 0)
+            continue;
+
+        if (fds[1].revents)
+        {
+            char drain[64];
+            while (::read(wakeFds[0], drain, sizeof(drain)) > 0)
+            {
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (fds[0].revents & POLLIN)
+            {
+                int fd;
+                while ((fd = ::accept(listenFd, nullptr, nullptr)) >= 0)
+                {
+                    // 部分平台上新连接继承监听套接字的 O_NONBLOCK; 写入改为由发送超时限制
+                    setNonBlocking(fd, false);
+                    timeval timeout = {SEND_TIMEOUT_S, 0};
+                    ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+                    connections.emplace(fd, Connection());
+                    idle.insert(fd);
+                }
+            }
+            for (size_t i = 2; i < fds.size(); ++i)
+            {
+                if (fds[i].revents)
+                {
+                    idle.erase(fds[i].fd);
+                    ready.push_back(fds[i].fd);
+                }
+            }
+            if (!ready.empty())
+                pending.notify_all();
+        }
+
+        // 多进程模式的工作进程只有一个线程, 由本循环轮流处理就绪的连接:
+        // 每轮每个连接处理一个请求, 之后回到 poll 接受新连接
+        size_t rounds = 0;
+        if (inlineRequests)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            rounds = ready.size();
+        }
+        for (; rounds > 0 && !stopping; --rounds)
+        {
+            int fd;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                fd = ready.front();
+                ready.pop_front();
+            }
+            serveReady(fd);
+        }
+    }
+#else
+    (void)inlineRequests;
+#endif
+}
+
+void Server::workerLoop()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    while (true)
+    {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            pending.wait(lock, [&]()
+                         { return stopping || !ready.empty(); });
+            if (stopping)
+                return;
+            fd = ready.front();
+            ready.pop_front();
+        }
+        serveReady(fd);
+    }
+#endif
+}
+
+void Server::serveReady(int fd)
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    Connection *conn;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        conn = &connections.at(fd); // 元素的引用在其他连接插入或删除时保持有效
+    }
+    bool open = serveRequest(fd, *conn);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!open)
+    {
+        connections.erase(fd);
+        ::close(fd);
+    }
+    else if (conn->buffer.find('\n', conn->scanned) != std::string::npos)
+    {
+        // 客户端连续发送了多个请求: 排到队尾, 与其他连接轮流处理
+        ready.push_back(fd);
+        pending.notify_one();
+    }
+    else
+    {
+        idle.insert(fd);
+        wake();
+    }
+#else
+    (void)fd;
+#endif
+}
+
+bool Server::serveRequest(int fd, Connection &conn)
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    size_t nl = conn.buffer.find('\n', conn.scanned);
+    if (nl == std::string::npos)
+    {
+        conn.scanned = conn.buffer.size();
+        if (conn.buffer.size() > MAX_REQUEST_BYTES)
+        {
+            sendAll(fd, errorResponse("Request exceeds " + std::to_string(MAX_REQUEST_BYTES) + " bytes"));
+            return false;
+        }
+        // poll 报告了可读, 只读一次, 不会阻塞
+        char chunk[1 << 16];
+        ssize_t n = ::read(fd, chunk, sizeof(chunk));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN))
+            return true;
+        if (n <= 0)
+            return false;
+        conn.buffer.append(chunk, static_cast<size_t>(n));
+        nl = conn.buffer.find('\n', conn.scanned);
+        if (nl == std::string::npos)
+            return true;
+    }
+
+    std::string line = conn.buffer.substr(0, nl);
+    conn.buffer.erase(0, nl + 1);
+    conn.scanned = 0;
+    if (line.find_first_not_of(" \t\r") == std::string::npos)
+        return true;
+
+    bool shutdown = false;
+    std::string response = handle(line, shutdown);
+    if (!sendAll(fd, response))
+        return false;
+    if (shutdown)
+    {
+        stop();
+        return false;
+    }
+    return true;
+#else
+    (void)fd;
+    (void)conn;
+    return false;
+#endif
+}
+
+void Server::stop()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+    pending.notify_all();
+    wake();
+#endif
+}
+
+void Server::openWakePipe()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    if (::pipe(wakeFds) != 0)
+        throw std::runtime_error("Cannot create the wake-up pipe");
+    setNonBlocking(wakeFds[0], true);
+    setNonBlocking(wakeFds[1], true);
+#endif
+}
+
+void Server::wake()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    // 管道已满说明 poll 线程已经会被唤醒
+    char c = 0;
+    if (wakeFds[1] >= 0 && ::write(wakeFds[1], &c, 1) < 0)
+    {
+    }
+#endif
+}
+
+void Server::closeConnections()
+{
+#ifdef LUDUS_HAS_UNIX_SOCKET
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : connections)
+        ::close(entry.first);
+    connections.clear();
+    idle.clear();
+    ready.clear();
+    for (int &fd : wakeFds)
+    {
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+    }
+#endif
+}
+
+std::string Server::handle(const std::string &line, bool &shutdown)
+{
+    auto start = std::chrono::steady_clock::now();
+    json req;
+    try
+    {
+        req = json::parse(line);
+    }
+    catch (const json::exception &ex)
+    {
+        return errorResponse(std::string("Invalid request: ") + ex.what());
+    }
+    if (!req.is_object())
+        return errorResponse("Invalid request: expected a JSON object");
+
+    std::string cmd = req.contains("cmd") && req["cmd"].is_string() ? req["cmd"].get<std::string>() : "run";
+    if (cmd == "stats")
+    {
+        json j = stats.toJson();
+        j["cached_programs"] = cache.size();
+#ifdef LUDUS_HAS_UNIX_SOCKET
+        j["pid"] = static_cast<long long>(::getpid());
+#endif
+        std::string body = j.dump();
+        return json{{"ok", true}, {"bytes", body.size()}}.dump() + "\n" + body;
+    }
+    if (cmd == "shutdown")
+    {
+        shutdown = true;
+        return json{{"ok", true}, {"bytes", 0}}.dump() + "\n";
+    }
+    if (cmd != "run")
+        return errorResponse("Unknown command '" + cmd + "'");
+
+    json header = {{"ok", true}};
+    std::string body;
+    try
+    {
+        body = runScript(req, header);
+    }
+    catch (const std::exception &ex)
+    {
+        stats.record(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), false, false);
+        return errorResponse(ex.what());
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.record(ms, true, header["cached"].get<bool>());
+    header["ms"] = ms;
+    header["bytes"] = body.size();
+    return header.dump() + "\n" + body;
+}
+
+std::string Server::runScript(const json &req, json &header)
+{
+    // 相对路径相对于服务进程的工作目录
+    std::optional<SourceFile> file;
+    std::string inlineSource;
+    std::string_view source;
+    if (req.contains("source"))
+    {
+        inlineSource = req.at("source").get<std::string>();
+        source = inlineSource;
+    }
+    else if (req.contains("script"))
+    {
+        file.emplace(req.at("script").get<std::string>());
+        source = file->view();
+    }
+    else
+    {
+        throw std::runtime_error("Request needs 'script', 'source' or 'cmd'");
+    }
+
+    std::string format = req.contains("format") ? req.at("format").get<std::string>() : "json";
+    if (format != "json" && format != "pretty")
+        throw std::runtime_error("Unknown output format '" + format + "'");
+
+    std::shared_ptr<const CompiledScript> script = cache.get(source);
+    bool hit = script != nullptr;
+    if (!script)
+    {
+        script = compile(source);
+        cache.put(source, script);
+    }
+    Program *program = script->program.get();
+
+    // 从前导段执行后的状态开始; 与 --param 相同, 参数在前导段之后赋值
+    Interpreter interpreter;
+    interpreter.setThreads(opts.threads);
+    interpreter.restoreState(script->prelude);
+    if (req.contains("params"))
+    {
+        const json &params = req.at("params");
+        if (!params.is_object())
+            throw std::runtime_error("'params' must be an object");
+        for (auto &param : params.items())
+            interpreter.setParam(param.key(), param.value().is_string() ? param.value().get<std::string>() : param.value().dump());
+    }
+    if (req.contains("index"))
+        interpreter.executeIndex(program, req.at("index").get<ll>(), script->first);
+    else
+        interpreter.executeRange(program, script->first, program->stmts.size());
+
+    header["cached"] = hit;
+    header["objects"] = interpreter.objectCount();
+    return interpreter.getOutput(format == "pretty");
+}
+
+std::shared_ptr<const CompiledScript> Server::compile(std::string_view source)
+{
+    auto script = std::make_shared<CompiledScript>();
+    script->program = parseProgram(source, opts.threads);
+    script->first = Interpreter::preludeLength(script->program.get());
+
+    Interpreter interpreter;
+    interpreter.setThreads(opts.threads);
+    interpreter.executeRange(script->program.get(), 0, script->first);
+    script->prelude = interpreter.captureState();
+    return script;
+}
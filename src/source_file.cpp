@@ -0,0 +1,59 @@
+#include "source_file.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define LUDUS_HAS_MMAP 1
+#endif
+
+SourceFile::SourceFile(const std::string &path)
+{
+#ifdef LUDUS_HAS_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open " + path);
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            // 词法分析从头到尾顺序读取
+            madvise(p, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+            mappedData = p;
+            data = static_cast<const char *>(p);
+            size = static_cast<size_t>(st.st_size);
+        }
+    }
+    close(fd);
+    if (mappedData)
+        return;
+#endif
+    readAll(path);
+}
+
+SourceFile::~SourceFile()
+{
+#ifdef LUDUS_HAS_MMAP
+    if (mappedData)
+        munmap(mappedData, size);
+#endif
+}
+
+void SourceFile::readAll(const std::string &path)
+{
+    std::ifstream ifs(path);
+    if (!ifs)
+        throw std::runtime_error("Cannot open " + path);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    buffer = ss.str();
+    data = buffer.data();
+    size = buffer.size();
+}
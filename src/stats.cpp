@@ -0,0 +1,90 @@
+#include "stats.h"
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+RunStats::Scope::~Scope()
+{
+    double wallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wall).count();
+    double cpuMs = static_cast<double>(std::clock() - cpu) * 1000.0 / CLOCKS_PER_SEC;
+    s.phases.push_back({name, wallMs, cpuMs});
+}
+
+long long RunStats::readPeakRssKb()
+{
+#if defined(__linux__)
+    // VmHWM: 常驻内存峰值
+    std::ifstream ifs("/proc/self/status");
+    std::string line;
+    while (std::getline(ifs, line))
+    {
+        if (line.compare(0, 6, "VmHWM:") == 0)
+            return std::stoll(line.substr(6));
+    }
+    return -1;
+#elif defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+    return static_cast<long long>(usage.ru_maxrss) / 1024; // macOS 以字节为单位
+#else
+    return -1;
+#endif
+}
+
+double RunStats::totalWallMs() const
+{
+    double total = 0;
+    for (auto &p : phases)
+        total += p.wallMs;
+    return total;
+}
+
+std::string RunStats::report() const
+{
+    double total = totalWallMs();
+    double seconds = total / 1000.0;
+
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(3);
+    oss << std::setw(12) << "phase" << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms" << "\n";
+    for (auto &p : phases)
+        oss << std::setw(12) << p.name << std::setw(12) << p.wallMs << std::setw(12) << p.cpuMs << "\n";
+    oss << std::setw(12) << "total" << std::setw(12) << total << "\n";
+    oss << "AST nodes: " << astNodes << ", objects: " << objects << ", bytes written: " << bytesWritten << "\n";
+    if (seconds > 0)
+    {
+        oss << std::setprecision(1) << "Throughput: " << static_cast<double>(objects) / seconds << " objects/s, "
+            << std::setprecision(3) << static_cast<double>(bytesWritten) / 1e6 / seconds << " MB/s\n";
+    }
+    if (peakRssKb >= 0)
+        oss << "Peak RSS: " << peakRssKb << " KiB\n";
+    return oss.str();
+}
+
+json RunStats::toJson() const
+{
+    double total = totalWallMs();
+    double seconds = total / 1000.0;
+
+    json j;
+    json phaseObj = json::object();
+    for (auto &p : phases)
+        phaseObj[p.name] = {{"wall_ms", p.wallMs}, {"cpu_ms", p.cpuMs}};
+    j["phases"] = phaseObj;
+    j["total_ms"] = total;
+    j["ast_nodes"] = astNodes;
+    j["objects"] = objects;
+    j["bytes_written"] = bytesWritten;
+    j["objects_per_sec"] = seconds > 0 ? static_cast<double>(objects) / seconds : 0.0;
+    j["mb_per_sec"] = seconds > 0 ? static_cast<double>(bytesWritten) / 1e6 / seconds : 0.0;
+    if (peakRssKb >= 0)
+        j["peak_rss_kb"] = peakRssKb;
+    else
+        j["peak_rss_kb"] = nullptr;
+    return j;
+}
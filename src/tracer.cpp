@@ -0,0 +1,85 @@
+#include "tracer.h"
+#include <algorithm>
+#include <set>
+
+Tracer::Tracer(size_t capacity, long long objSample, size_t reserved)
+    : structure(std::max<size_t>(reserved, 1)), samples(std::max<size_t>(capacity, 1)),
+      objSample(std::max(objSample, 1LL)) {}
+
+void Tracer::append(Buffer &buffer, const Event &e)
+{
+    // 编号唯一, 槽位只会被一个线程写入
+    std::uint64_t ticket = buffer.next.fetch_add(1, std::memory_order_relaxed);
+    if (ticket >= buffer.slots.size())
+        return;
+    Slot &slot = buffer.slots[ticket];
+    slot.event = e;
+    slot.ready.store(true, std::memory_order_release);
+}
+
+size_t Tracer::overflow(const Buffer &buffer)
+{
+    std::uint64_t n = buffer.next.load(std::memory_order_relaxed);
+    return n > buffer.slots.size() ? static_cast<size_t>(n - buffer.slots.size()) : 0;
+}
+
+void Tracer::record(const char *name, const std::string *detail, int line, unsigned tid,
+                    std::uint64_t begin, std::uint64_t end, bool sampled)
+{
+    append(sampled ? samples : structure, {name, detail, line, tid, begin, end});
+}
+
+size_t Tracer::dropped() const
+{
+    return overflow(structure) + overflow(samples);
+}
+
+json Tracer::toJson() const
+{
+    double ticksPerUs = clock.ticksPerMs() / 1000.0;
+    std::uint64_t origin = clock.startTicks();
+    auto us = [&](std::uint64_t ticks)
+    {
+        return ticks > origin ? static_cast<double>(ticks - origin) / ticksPerUs : 0.0;
+    };
+
+    // 先输出结构事件再输出采样事件, 查看器按时间戳排列; 跳过仍在写入的槽位
+    json events = json::array();
+    std::set<unsigned> tids;
+    for (const Buffer *buffer : {&structure, &samples})
+    {
+        for (const Slot &slot : buffer->slots)
+        {
+            if (!slot.ready.load(std::memory_order_acquire))
+                continue;
+            const Event &e = slot.event;
+            json ev = {{"name", e.detail ? std::string(e.name) + " " + *e.detail : std::string(e.name)},
+                       {"cat", "luduscript"},
+                       {"ph", "X"},
+                       {"pid", 1},
+                       {"tid", e.tid},
+                       {"ts", us(e.begin)},
+                       {"dur", e.end > e.begin ? static_cast<double>(e.end - e.begin) / ticksPerUs : 0.0}};
+            if (e.line > 0)
+                ev["args"]["line"] = e.line;
+            events.push_back(std::move(ev));
+            tids.insert(e.tid);
+        }
+    }
+
+    // Thread name metadata 线程名
+    for (unsigned tid : tids)
+    {
+        events.push_back({{"name", "thread_name"},
+                          {"ph", "M"},
+                          {"pid", 1},
+                          {"tid", tid},
+                          {"args", {{"name", tid == 0 ? std::string("main") : "worker " + std::to_string(tid)}}}});
+    }
+
+    json j;
+    j["traceEvents"] = events;
+    j["displayTimeUnit"] = "ms";
+    j["otherData"] = {{"dropped_events", dropped()}};
+    return j;
+}
@@ -0,0 +1,44 @@
+// 损坏文件内容的测试工具: 翻转文件中第一次出现的 text 的首字节的最低位
+// 用于构造结构完好、只有内容被改动的编译缓存和前导段快照(CMake 脚本无法写入含 NUL 的二进制文件)
+// 用法: luduscript_flip_byte <file> <text>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <file> <text>" << std::endl;
+        return 1;
+    }
+
+    std::string data;
+    {
+        std::ifstream in(argv[1], std::ios::binary);
+        if (!in)
+        {
+            std::cerr << "Cannot open " << argv[1] << std::endl;
+            return 1;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    size_t at = data.find(argv[2]);
+    if (at == std::string::npos)
+    {
+        std::cerr << "'" << argv[2] << "' not found in " << argv[1] << std::endl;
+        return 1;
+    }
+    data[at] = static_cast<char>(data[at] ^ 1);
+
+    std::ofstream out(argv[1], std::ios::binary | std::ios::trunc);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!out)
+    {
+        std::cerr << "Cannot write " << argv[1] << std::endl;
+        return 1;
+    }
+    return 0;
+}
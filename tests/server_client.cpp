@@ -0,0 +1,287 @@
+// --serve 协议测试客户端: 启动常驻服务, 在一个连接上依次发送请求并检查响应
+// 用法: luduscript_server_test <luduscript> <socket> <examples 目录> [--prefork]
+// --prefork 时服务以 2 个工作进程运行并预先编译 e12.gen, 第一次请求即命中缓存
+#include "nlohmann/json.hpp"
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using json = nlohmann::json;
+
+namespace
+{
+    constexpr int STARTUP_TIMEOUT_MS = 10000;
+    constexpr int REPLY_TIMEOUT_MS = 30000;
+
+    void check(bool condition, const std::string &message)
+    {
+        if (!condition)
+            throw std::runtime_error(message);
+    }
+
+    json readJsonFile(const std::string &path)
+    {
+        std::ifstream in(path);
+        check(in.good(), "Cannot open " + path);
+        return json::parse(in);
+    }
+
+    struct Reply
+    {
+        json header;
+        std::string body;
+    };
+
+    class Connection
+    {
+    public:
+        explicit Connection(const std::string &socketPath)
+        {
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            check(socketPath.size() < sizeof(addr.sun_path), "Socket path too long: " + socketPath);
+            socketPath.copy(addr.sun_path, socketPath.size());
+
+            // 服务启动需要时间, 在超时前反复尝试连接
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(STARTUP_TIMEOUT_MS);
+            while (true)
+            {
+                fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                check(fd >= 0, "Cannot create socket");
+                if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0)
+                    return;
+                ::close(fd);
+                fd = -1;
+                check(std::chrono::steady_clock::now() < deadline, "Server did not start listening on " + socketPath);
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            }
+        }
+
+        ~Connection()
+        {
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        Connection(const Connection &) = delete;
+        Connection &operator=(const Connection &) = delete;
+
+        void send(std::string_view data)
+        {
+            while (!data.empty())
+            {
+                ssize_t n = ::write(fd, data.data(), data.size());
+                if (n < 0 && errno == EINTR)
+                    continue;
+                check(n > 0, "Cannot send " + std::string(data));
+                data.remove_prefix(static_cast<size_t>(n));
+            }
+        }
+
+        // 发送一行请求, 读取头部行和 bytes 指定长度的正文
+        Reply request(const json &req)
+        {
+            send(req.dump() + "\n");
+
+            size_t nl;
+            while ((nl = buffer.find('\n')) == std::string::npos)
+                fill(req);
+            Reply reply;
+            reply.header = json::parse(buffer.substr(0, nl));
+            buffer.erase(0, nl + 1);
+            size_t bytes = reply.header.value("bytes", size_t(0));
+            while (buffer.size() < bytes)
+                fill(req);
+            reply.body = buffer.substr(0, bytes);
+            buffer.erase(0, bytes);
+            return reply;
+        }
+
+    private:
+        int fd = -1;
+        std::string buffer;
+
+        void fill(const json &req)
+        {
+            pollfd pfd = {fd, POLLIN, 0};
+            check(::poll(&pfd, 1, REPLY_TIMEOUT_MS) > 0, "Timed out waiting for the reply to " + req.dump());
+            char chunk[1 << 16];
+            ssize_t n = ::read(fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR)
+                return;
+            check(n > 0, "Server closed the connection before replying to " + req.dump());
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    };
+
+    Reply expectOk(Connection &conn, const json &req)
+    {
+        Reply reply = conn.request(req);
+        check(reply.header.value("ok", false), "Request " + req.dump() + " failed: " + reply.header.dump());
+        return reply;
+    }
+
+    void expectError(Connection &conn, const json &req, const std::string &fragment)
+    {
+        Reply reply = conn.request(req);
+        check(!reply.header.value("ok", true), "Request " + req.dump() + " should fail: " + reply.header.dump());
+        std::string error = reply.header.value("error", "");
+        check(error.find(fragment) != std::string::npos,
+              "Error for " + req.dump() + " should mention '" + fragment + "': " + error);
+    }
+
+    void expectOutput(const Reply &reply, const std::string &expectedFile)
+    {
+        check(json::parse(reply.body) == readJsonFile(expectedFile), "Output differs from " + expectedFile);
+    }
+
+    // 在服务和客户端之间只经过一个连接, 多进程模式下所有请求由同一个工作进程处理, stats 可以精确比较
+    void runChecks(const std::string &socketPath, const std::string &examples, bool preloaded)
+    {
+        std::string e12 = examples + "/in/e12.gen";
+        std::string poker = examples + "/in/poker.gen";
+
+        // 服务只有 2 个工作线程(或进程): 保持打开的空闲连接和只发送了半个请求的连接不能占住它们
+        Connection idle1(socketPath);
+        Connection idle2(socketPath);
+        Connection partial(socketPath);
+        partial.send("{\"cmd\": \"sta");
+
+        Connection conn(socketPath);
+
+        Reply first = expectOk(conn, {{"script", e12}, {"format", "pretty"}});
+        expectOutput(first, examples + "/out/e12.json");
+        check(first.header.value("cached", !preloaded) == preloaded, "Unexpected cache state for the first run: " + first.header.dump());
+        check(first.header.value("objects", 0) == 5, "Expected 5 objects: " + first.header.dump());
+
+        Reply second = expectOk(conn, {{"script", e12}, {"format", "pretty"}});
+        expectOutput(second, examples + "/out/e12.json");
+        check(second.header.value("cached", false), "Second run should hit the cache: " + second.header.dump());
+
+        // 参数在前导段之后赋值, 不影响缓存中的状态
+        Reply param = expectOk(conn, {{"script", e12}, {"params", {{"card_id", 10}}}});
+        expectOutput(param, examples + "/out/e12_param10.json");
+        Reply again = expectOk(conn, {{"script", e12}});
+        expectOutput(again, examples + "/out/e12.json");
+
+        Reply index = expectOk(conn, {{"script", poker}, {"index", 13}, {"format", "pretty"}});
+        expectOutput(index, examples + "/out/poker_index13.json");
+        check(index.header.value("objects", 0) == 1, "Index request should produce one object: " + index.header.dump());
+
+        expectError(conn, {{"script", e12}, {"params", {{"card_id", "abc"}}}}, "must be a num");
+        expectError(conn, {{"source", "undefined_fn(1)\n"}}, "Undefined function");
+        expectError(conn, {{"cmd", "reboot"}}, "Unknown command");
+
+        // 过深的嵌套和递归不能耗尽栈空间使服务崩溃
+        expectError(conn, {{"source", "num(x){" + std::string(200000, '(')}}, "Nesting too deep");
+        std::string nested;
+        for (int i = 0; i < 40; ++i)
+            nested += "if(true){";
+        nested += "r = f(k - 1) + 1";
+        nested += std::string(40, '}');
+        expectError(conn, {{"source", "fn f(k){ num(r){0} if(k > 0){ " + nested + " } r }\nobj(\"A\", 1){ num(v){ f(255) } }\n"}},
+                    "Maximum call depth exceeded");
+
+        // 出错后连接仍然可用
+        Reply stats = expectOk(conn, {{"cmd", "stats"}});
+        json s = json::parse(stats.body);
+        check(s.value("requests", 0) == 9, "Expected 9 script requests: " + stats.body);
+        check(s.value("errors", 0) == 4, "Expected 4 failed requests: " + stats.body);
+        check(s.value("cache_hits", 0) == (preloaded ? 4 : 3), "Unexpected cache hits: " + stats.body);
+        check(s.value("cache_misses", 0) == (preloaded ? 1 : 2), "Unexpected cache misses: " + stats.body);
+        check(s.value("pid", 0LL) > 0, "Stats should report the worker pid: " + stats.body);
+
+        Reply shutdown = expectOk(conn, {{"cmd", "shutdown"}});
+        check(shutdown.body.empty(), "Shutdown reply should have no body");
+    }
+
+    // 等待服务进程退出, 超时返回 false
+    bool waitExit(pid_t pid, int timeoutMs, int &status)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            pid_t r = ::waitpid(pid, &status, WNOHANG);
+            if (r == pid)
+                return true;
+            if (r < 0 && errno != EINTR)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <luduscript> <socket> <examples dir> [--prefork]" << std::endl;
+        return 1;
+    }
+    std::string luduscript = argv[1];
+    std::string socketPath = argv[2];
+    std::string examples = argv[3];
+    bool prefork = argc > 4 && std::string(argv[4]) == "--prefork";
+
+    std::vector<std::string> args = {luduscript, "--serve", socketPath, "--workers", "2"};
+    if (prefork)
+        args = {luduscript, "--serve", socketPath, "--prefork", "2", "--preload", examples + "/in/e12.gen"};
+
+    // 服务端向已断开的连接写入时不应终止测试进程
+    std::signal(SIGPIPE, SIG_IGN);
+    ::unlink(socketPath.c_str());
+    pid_t server = ::fork();
+    if (server < 0)
+    {
+        std::cerr << "Cannot fork the server process" << std::endl;
+        return 1;
+    }
+    if (server == 0)
+    {
+        std::vector<char *> argvServer;
+        for (auto &arg : args)
+            argvServer.push_back(const_cast<char *>(arg.c_str()));
+        argvServer.push_back(nullptr);
+        ::execv(argvServer[0], argvServer.data());
+        ::_exit(127);
+    }
+
+    int status = 0;
+    try
+    {
+        runChecks(socketPath, examples, prefork);
+        check(waitExit(server, STARTUP_TIMEOUT_MS, status), "Server did not exit after shutdown");
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "Server exited with status " + std::to_string(status));
+        check(::access(socketPath.c_str(), F_OK) != 0, "Server left the socket file behind");
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "FAIL: " << ex.what() << std::endl;
+        // 多进程模式下父进程收到 SIGTERM 后结束工作进程; 直接 SIGKILL 会留下工作进程
+        ::kill(server, SIGTERM);
+        if (!waitExit(server, STARTUP_TIMEOUT_MS, status))
+        {
+            ::kill(server, SIGKILL);
+            ::waitpid(server, &status, 0);
+        }
+        ::unlink(socketPath.c_str());
+        return 1;
+    }
+
+    std::cout << "Server protocol checks passed" << (prefork ? " (prefork)" : "") << std::endl;
+    return 0;
+}
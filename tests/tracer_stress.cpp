@@ -0,0 +1,84 @@
+// 时间线记录器的并发测试: 4 个线程同时向很小的缓冲区写入采样事件和结构事件,
+// 检查写满后保留的是最早的事件、结构事件不被采样事件挤掉、丢弃数准确. 在 ThreadSanitizer 构建中同时检查数据竞争
+#include "tracer.h"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr unsigned THREADS = 4;
+    constexpr size_t SAMPLE_SLOTS = 64;
+    constexpr size_t RESERVED_SLOTS = 16;
+    constexpr int OBJS_PER_THREAD = 10000;
+
+    void check(bool condition, const std::string &message)
+    {
+        if (!condition)
+            throw std::runtime_error(message);
+    }
+
+    size_t countEvents(const json &trace, const std::string &name)
+    {
+        size_t n = 0;
+        for (auto &ev : trace.at("traceEvents"))
+            if (ev.at("ph") == "X" && ev.at("name") == name)
+                ++n;
+        return n;
+    }
+
+    void run()
+    {
+        Tracer tracer(SAMPLE_SLOTS, 1, RESERVED_SLOTS);
+        std::string className = "Card";
+        {
+            // 外层阶段事件在所有对象事件之后才结束并记录
+            Tracer::Scope phase(tracer, "execute");
+            std::vector<std::thread> pool;
+            for (unsigned t = 0; t < THREADS; ++t)
+            {
+                pool.emplace_back([&, t]()
+                                  {
+                    Tracer::Scope chunk(tracer, "chunk", nullptr, 1, t + 1);
+                    for (int i = 0; i < OBJS_PER_THREAD; ++i)
+                        Tracer::Scope obj(tracer, "obj", &className, 2, t + 1, true); });
+            }
+            for (auto &th : pool)
+                th.join();
+        }
+
+        json trace = tracer.toJson();
+        size_t total = THREADS * OBJS_PER_THREAD;
+        check(countEvents(trace, "obj Card") == SAMPLE_SLOTS,
+              "Expected " + std::to_string(SAMPLE_SLOTS) + " obj events, got " + std::to_string(countEvents(trace, "obj Card")));
+        check(countEvents(trace, "chunk") == THREADS, "Every chunk event should be kept");
+        check(countEvents(trace, "execute") == 1, "The execute phase recorded after the buffer filled up should be kept");
+        check(tracer.dropped() == total - SAMPLE_SLOTS, "Unexpected dropped count " + std::to_string(tracer.dropped()));
+        check(trace.at("otherData").at("dropped_events") == tracer.dropped(), "dropped_events differs from dropped()");
+
+        // 保留区同样写满后丢弃新事件
+        for (size_t i = 0; i < RESERVED_SLOTS; ++i)
+            tracer.record("statement", nullptr, 3, 0, 0, 0);
+        trace = tracer.toJson();
+        check(countEvents(trace, "statement") == RESERVED_SLOTS - THREADS - 1, "Reserved area should keep the earliest events");
+        check(countEvents(trace, "execute") == 1 && countEvents(trace, "chunk") == THREADS, "Earlier structure events were overwritten");
+        check(tracer.dropped() == total - SAMPLE_SLOTS + THREADS + 1, "Unexpected dropped count after filling the reserved area");
+    }
+}
+
+int main()
+{
+    try
+    {
+        run();
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "FAIL: " << ex.what() << std::endl;
+        return 1;
+    }
+    std::cout << "Tracer checks passed" << std::endl;
+    return 0;
+}